@@ -0,0 +1,89 @@
+#ifndef CHUNKGRID_H
+#define CHUNKGRID_H
+
+#include <QPoint>
+#include <array>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// A w x h grid of pointers, most of them null, stored in square chunks of
+// CHUNK_SIZE x CHUNK_SIZE cells. A chunk only exists while one of its cells is
+// set, so an empty part of a large map costs one null pointer per chunk; a
+// cell is found with two shifts and two masks.
+template <class T> class ChunkGrid {
+public:
+  static constexpr int CHUNK_BITS = 5;
+  static constexpr int CHUNK_SIZE = 1 << CHUNK_BITS;
+
+  explicit ChunkGrid(int w = 0, int h = 0) { reset(w, h); }
+
+  void reset(int w, int h) { // every cell empty
+    assert(w >= 0 && h >= 0);
+    stride = (w + CHUNK_SIZE - 1) >> CHUNK_BITS;
+    chunks.clear();
+    chunks.resize(stride * ((h + CHUNK_SIZE - 1) >> CHUNK_BITS));
+  }
+
+  void grow(int w, int h) { // to a larger w x h, the cells are kept
+    int grownStride = (w + CHUNK_SIZE - 1) >> CHUNK_BITS;
+    assert(grownStride >= stride);
+    std::vector<std::unique_ptr<Chunk>> grown(
+        grownStride * ((h + CHUNK_SIZE - 1) >> CHUNK_BITS));
+    assert(grown.size() >= chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+      grown[i / stride * grownStride + i % stride] = std::move(chunks[i]);
+    }
+    stride = grownStride;
+    chunks.swap(grown);
+  }
+
+  T get(int x, int y) const {
+    const Chunk *c = chunks[chunkIndex(x, y)].get();
+    return c ? c->cells[cellIndex(x, y)] : nullptr;
+  }
+  T get(QPoint p) const { return get(p.x(), p.y()); }
+
+  void set(int x, int y, T value) {
+    auto &c = chunks[chunkIndex(x, y)];
+    if (!c) {
+      if (!value) {
+        return;
+      }
+      c.reset(new Chunk);
+    }
+    T &cell = c->cells[cellIndex(x, y)];
+    c->used += (value != nullptr) - (cell != nullptr);
+    cell = value;
+    if (c->used == 0) {
+      c.reset();
+    }
+  }
+  void set(QPoint p, T value) { set(p.x(), p.y(), value); }
+
+  int chunkCount() const { // allocated ones
+    int n = 0;
+    for (auto &c : chunks) {
+      n += c != nullptr;
+    }
+    return n;
+  }
+
+private:
+  struct Chunk {
+    std::array<T, CHUNK_SIZE * CHUNK_SIZE> cells{};
+    int used = 0; // cells that are not null
+  };
+
+  int chunkIndex(int x, int y) const {
+    return (y >> CHUNK_BITS) * stride + (x >> CHUNK_BITS);
+  }
+  static int cellIndex(int x, int y) {
+    return ((y & (CHUNK_SIZE - 1)) << CHUNK_BITS) | (x & (CHUNK_SIZE - 1));
+  }
+
+  int stride; // chunks per row
+  std::vector<std::unique_ptr<Chunk>> chunks;
+};
+
+#endif // CHUNKGRID_H
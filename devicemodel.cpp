@@ -0,0 +1,1000 @@
+#include "devicemodel.h"
+#include <set>
+
+DeviceModel::DeviceModel(const QList<QPoint> &blocks)
+    : blocks_(blocks), frameCount(0), scheduler(nullptr), interval(-1),
+      due(0), slot(nullptr), slotIndex(-1) {
+  assert(!blocks.empty());
+}
+
+DeviceModel::~DeviceModel() {}
+
+void DeviceModel::save(QDataStream &out) { out << frameCount << blocks_; }
+
+const QList<QPoint> &DeviceModel::blocks() const { return blocks_; }
+
+SlotId DeviceModel::id() const { return id_; }
+
+void DeviceModel::wake() {
+  if (scheduler) {
+    scheduler->wake(this);
+  }
+}
+
+DeviceModel::DeviceModel(QDataStream &in)
+    : scheduler(nullptr), interval(-1), due(0), slot(nullptr),
+      slotIndex(-1) {
+  in >> frameCount >> blocks_;
+  assert(blocks_.size() >= 1);
+}
+
+MinerModel::MinerModel(ItemFactory *factory)
+    : DeviceModel(), factory(factory) {}
+
+qreal MinerModel::ratio_ = 1;
+
+void MinerModel::save(QDataStream &out) { DeviceModel::save(out); }
+
+void MinerModel::restore(ItemFactory *f) {
+  factory = f;
+  wake();
+}
+
+PortRange MinerModel::ports() { return PortRange(this, LAYOUT); }
+
+Port *MinerModel::port(int k) {
+  assert(k == 0);
+  return &out;
+}
+
+MinerModel::MinerModel(QDataStream &in) : DeviceModel(in), factory(nullptr) {}
+
+bool MinerModel::next() {
+  if (!factory)
+    return false;
+  if (!out.ready())
+    return false;
+  return out.send(factory->createItem());
+}
+
+qreal MinerModel::speed() { return MINER_SPEED; }
+
+qreal MinerModel::ratio() { return ratio_; }
+
+BeltModel::BeltModel(const QList<QPoint> &blocks, rotate_t inDirection,
+                     rotate_t outDirection)
+    : DeviceModel(blocks),
+      layout{{blocks.front(), rotate_t((inDirection + 2) % 4)},
+             {blocks.back(), outDirection}},
+      inDirection(inDirection), outDirection(outDirection) {
+  length_ = blocks.size();
+  direction_.resize(length_);
+  turn_.resize(length_);
+
+  direction_.back() = outDirection;
+  for (int i = length_ - 2; i >= 0; i--) {
+    QPoint p = blocks[i], np = blocks[i + 1];
+    for (int d = 0; d < 4; d++) {
+      if (p + QPoint(dx[d], dy[d]) == np) {
+        direction_[i] = rotate_t(d);
+        break;
+      }
+    }
+  }
+
+  if (inDirection == direction_.front()) {
+    turn_.front() = PASS_THROUGH;
+  } else if (rotateL(inDirection) == direction_.front()) {
+    turn_.front() = TURN_LEFT;
+  } else if (rotateR(inDirection) == direction_.front()) {
+    turn_.front() = TURN_RIGHT;
+  } else {
+    assert(false);
+  }
+
+  for (int i = 1; i < length_; i++) {
+    QPoint pp = blocks[i - 1], p = blocks[i];
+    rotate_t inD;
+    for (int d = 0; d < 4; d++) {
+      if (pp + dp[d] == p) {
+        inD = rotate_t(d);
+        break;
+      }
+    }
+
+    if (inD == direction_[i]) {
+      turn_[i] = PASS_THROUGH;
+    } else if (rotateL(inD) == direction_[i]) {
+      turn_[i] = TURN_LEFT;
+    } else if (rotateR(inD) == direction_[i]) {
+      turn_[i] = TURN_RIGHT;
+    } else {
+      assert(false);
+    }
+  }
+  path = new BeltPath(this);
+}
+
+BeltModel::~BeltModel() {
+  // Simulation has editPaths() leave an installed belt alone before deleting
+  // it
+  assert(path->head() == this && path->tail() == this);
+  delete path;
+}
+
+qreal BeltModel::ratio_ = 1;
+
+void BeltModel::save(QDataStream &out) {
+  DeviceModel::save(out);
+  out << inDirection << outDirection;
+
+  out << length_;
+
+  for (int i = 0; i < length_; i++) {
+    out << direction_[i];
+  }
+  for (int i = 0; i < length_; i++) {
+    out << turn_[i];
+  }
+}
+
+PortRange BeltModel::ports() { return PortRange(this, layout); }
+
+Port *BeltModel::port(int k) {
+  assert(k == 0 || k == 1);
+  return k == 0 ? static_cast<Port *>(&in) : &out;
+}
+
+const BeltPath *BeltModel::getPath() const { return path; }
+
+int BeltModel::length() const { return length_; }
+
+rotate_t BeltModel::direction(int block) const { return direction_[block]; }
+
+BeltModel::turn_t BeltModel::turn(int block) const { return turn_[block]; }
+
+QList<QPair<const Item *, int>> BeltModel::items() const {
+  QList<QPair<const Item *, int>> ret;
+  int begin = offset * L, end = (offset + length_) * L;
+  for (auto &[item, pos] : path->positions()) {
+    if (begin <= pos && pos < end) {
+      ret.push_back({item, pos - begin});
+    }
+  }
+  return ret;
+}
+
+void BeltModel::wake() { path->head()->DeviceModel::wake(); }
+
+void BeltModel::editPaths(const std::vector<BeltModel *> &removed,
+                          const std::vector<BeltModel *> &installed) {
+  // a belt may be installed and removed in the same batch
+  std::unordered_set<BeltModel *> gone(removed.begin(), removed.end());
+  std::vector<BeltModel *> loose;
+  for (auto belt : installed) {
+    if (!gone.count(belt)) {
+      loose.push_back(belt);
+    }
+  }
+  // a path is split once, around all of its removed belts
+  for (auto belt : removed) {
+    if (belt->path->segments.size() > 1) {
+      for (auto head : BeltPath::split(belt->path, gone)) {
+        loose.push_back(head);
+      }
+    }
+  }
+  BeltPath::join(loose);
+}
+
+const Item *BeltModel::outBuffer() { return out.getBuffer(); }
+
+BeltModel::BeltModel(QDataStream &in) : DeviceModel(in) {
+  in >> inDirection >> outDirection;
+  layout[0] = {blocks().front(), rotate_t((inDirection + 2) % 4)};
+  layout[1] = {blocks().back(), outDirection};
+
+  in >> length_;
+  assert(length_ > 0);
+  direction_.resize(length_);
+  turn_.resize(length_);
+  for (auto &x : direction_) {
+    in >> x;
+  }
+  for (auto &x : turn_) {
+    in >> x;
+  }
+  path = new BeltPath(this);
+}
+
+bool BeltModel::next() {
+  // the other segments sleep until they head a path of their own
+  return path->head() == this && path->next();
+}
+
+qreal BeltModel::speed() { return BELT_SPEED; }
+
+qreal BeltModel::ratio() { return ratio_; }
+
+// a belt moves its items L/10 at a time and keeps them more than 0.9 L apart
+static const int BELT_STEP = L / 10;
+static const qreal BELT_SPACING = 0.9 * L;
+
+int BeltModel::callsPerItem() {
+  // an item enters once the one before it is more than BELT_SPACING in, and
+  // the call that hands the head item on moves nothing else
+  return int(BELT_SPACING) / BELT_STEP + 2;
+}
+
+BeltPath::BeltPath(BeltModel *belt) : segments({belt}) {
+  adopt();
+  assign({});
+}
+
+BeltPath::BeltPath(const QList<BeltModel *> &segments, const positions_t &items)
+    : segments(segments) {
+  adopt();
+  assign(items);
+}
+
+void BeltPath::adopt() {
+  length_ = 0;
+  for (auto belt : segments) {
+    belt->path = this;
+    belt->offset = length_;
+    length_ += belt->length_;
+  }
+}
+
+BeltPath::positions_t BeltPath::positions() const {
+  positions_t ret;
+  int pos = headPos;
+  for (int i = 0; i < items.size(); i++) {
+    ret.push_back({items[i], pos});
+    if (i < gaps.size()) {
+      pos -= gaps[i];
+    }
+  }
+  return ret;
+}
+
+void BeltPath::assign(const positions_t &list) {
+  stamp_ = nextStamp++;
+  items.clear();
+  gaps.clear();
+  headPos = tailPos = 0;
+  firstLoose = 0;
+  for (auto &[item, pos] : list) {
+    if (!items.empty()) {
+      assert(tailPos - pos > BELT_SPACING);
+      gaps.push_back(tailPos - pos);
+    } else {
+      headPos = pos;
+    }
+    items.push_back(item);
+    tailPos = pos;
+  }
+}
+
+BeltModel *BeltPath::head() const { return segments.front(); }
+
+BeltModel *BeltPath::tail() const { return segments.back(); }
+
+int BeltPath::length() const { return length_; }
+
+std::atomic<quint64> BeltPath::nextStamp(1);
+
+quint64 BeltPath::stamp() const { return stamp_; }
+
+std::vector<std::pair<BeltModel *, BeltPath::positions_t>>
+BeltPath::segmentItems() const {
+  std::vector<std::pair<BeltModel *, positions_t>> ret(segments.size());
+  positions_t list = positions();
+  // from the last segment back, as the front of list is farthest along
+  auto it = list.begin();
+  for (int i = segments.size() - 1; i >= 0; i--) {
+    BeltModel *belt = segments[i];
+    int begin = belt->offset * L;
+    ret[i].first = belt;
+    for (; it != list.end() && it->second >= begin; ++it) {
+      ret[i].second.push_back({it->first, it->second - begin});
+    }
+  }
+  return ret;
+}
+
+BeltPath *BeltPath::up() const {
+  auto belt = dynamic_cast<BeltModel *>(head()->in.getPeerOwner());
+  return belt ? belt->path : nullptr;
+}
+
+BeltPath *BeltPath::down() const {
+  auto belt = dynamic_cast<BeltModel *>(tail()->out.getPeerOwner());
+  return belt ? belt->path : nullptr;
+}
+
+void BeltPath::join(const std::vector<BeltModel *> &belts) {
+  std::unordered_set<BeltPath *> pending;
+  for (auto belt : belts) {
+    pending.insert(belt->path);
+  }
+  for (auto belt : belts) {
+    BeltPath *path = belt->path;
+    if (!pending.count(path)) {
+      continue; // merged with an earlier one
+    }
+    // a path has at most one path up of it, so walking up either reaches
+    // the first path of the chain or goes round a loop back to path
+    BeltPath *first = path;
+    for (BeltPath *up = path->up(); up && up != path; up = up->up()) {
+      first = up;
+    }
+    std::vector<BeltPath *> chain = {first};
+    for (BeltPath *down = first->down(); down && down != first;
+         down = down->down()) {
+      chain.push_back(down);
+    }
+    for (auto p : chain) {
+      pending.erase(p);
+    }
+    if (chain.size() > 1) {
+      merge(chain);
+    }
+    first->head()->wake();
+  }
+}
+
+void BeltPath::merge(const std::vector<BeltPath *> &chain) {
+  std::vector<int> shift(chain.size(), 0); // of each path along the first
+  for (size_t i = 1; i < chain.size(); i++) {
+    shift[i] = shift[i - 1] + chain[i - 1]->length_ * L;
+  }
+  positions_t list;
+  for (size_t i = chain.size(); i-- > 0;) {
+    for (auto &[item, pos] : chain[i]->positions()) {
+      list.push_back({item, pos + shift[i]});
+    }
+    if (i == 0) {
+      break;
+    }
+    // the item waiting at the joint goes on the belt, joints never buffer.
+    // It waited because the last item down of it was too close, so it may
+    // have to sit a little further back.
+    BeltModel *up = chain[i - 1]->tail();
+    if (up->out.valid()) {
+      int pos = shift[i] - 1;
+      if (!list.empty()) {
+        pos = qMin(pos, list.back().second - int(BELT_SPACING) - 1);
+      }
+      list.push_back({up->out.transmit(), pos});
+    }
+  }
+  BeltPath *first = chain.front();
+  for (size_t i = 1; i < chain.size(); i++) {
+    first->segments.append(chain[i]->segments);
+    chain[i]->segments.clear();
+    delete chain[i];
+  }
+  first->adopt();
+  first->assign(list);
+}
+
+std::vector<BeltModel *>
+BeltPath::split(BeltPath *path, const std::unordered_set<BeltModel *> &gone) {
+  positions_t list = path->positions();
+  QList<BeltModel *> segments;
+  segments.swap(path->segments);
+  delete path;
+  std::vector<BeltModel *> heads;
+  // from the last segment back, as the front of list is farthest along
+  auto it = list.begin();
+  for (int end = segments.size(); end > 0;) {
+    if (gone.count(segments[end - 1])) {
+      // items on a removed belt go with it
+      BeltModel *belt = segments[--end];
+      for (; it != list.end() && it->second >= belt->offset * L; ++it) {
+      }
+      new BeltPath(belt); // the paths are owned by their segments
+      continue;
+    }
+    int begin = end;
+    while (begin > 0 && !gone.count(segments[begin - 1])) {
+      begin--;
+    }
+    int shift = segments[begin]->offset * L;
+    positions_t items;
+    for (; it != list.end() && it->second >= shift; ++it) {
+      items.push_back({it->first, it->second - shift});
+    }
+    QList<BeltModel *> run = segments.mid(begin, end - begin);
+    heads.push_back(run.front());
+    new BeltPath(run, items);
+    end = begin;
+  }
+  return heads;
+}
+
+bool BeltPath::next() {
+  BeltModel *h = head(), *t = tail();
+  int beltLength = length_ * L;
+  bool moved = false;
+  if (!items.empty()) {
+    if (!t->out.ready()) {
+      // the last block holds the item waiting in the output
+      beltLength -= L;
+    } else if (headPos + BELT_STEP >= beltLength) {
+      t->out.send(items.front());
+      beltLength -= L;
+      items.pop_front();
+      if (!gaps.empty()) {
+        headPos -= gaps.front();
+        gaps.pop_front();
+        firstLoose = qMax(firstLoose - 1, 0);
+      }
+      moved = true;
+    }
+  }
+  if (!items.empty()) {
+    if (headPos + BELT_STEP < beltLength) {
+      // everything moves
+      headPos += BELT_STEP;
+      tailPos += BELT_STEP;
+      moved = true;
+    } else {
+      while (firstLoose < gaps.size() &&
+             gaps[firstLoose] <= BELT_STEP + BELT_SPACING) {
+        firstLoose++;
+      }
+      if (firstLoose < gaps.size()) {
+        // the items behind gaps[firstLoose] move
+        gaps[firstLoose] -= BELT_STEP;
+        tailPos += BELT_STEP;
+        moved = true;
+      }
+    }
+  }
+  if (items.empty() || BELT_SPACING < tailPos) {
+    if (h->in.ready()) {
+      if (items.empty()) {
+        headPos = 0;
+      } else {
+        gaps.push_back(tailPos);
+      }
+      items.push_back(h->in.receive());
+      tailPos = 0;
+      moved = true;
+    }
+  }
+  if (moved) {
+    stamp_ = nextStamp.fetch_add(1, std::memory_order_relaxed);
+  }
+  return moved;
+}
+
+TrashModel::TrashModel() : DeviceModel() {}
+
+qreal TrashModel::ratio_;
+
+void TrashModel::save(QDataStream &out) { DeviceModel::save(out); }
+
+PortRange TrashModel::ports() { return PortRange(this, LAYOUT); }
+
+Port *TrashModel::port(int k) { return &in.at(k); }
+
+TrashModel::TrashModel(QDataStream &in) : DeviceModel(in) {}
+
+bool TrashModel::next() {
+  bool received = false;
+  for (auto &port : in) {
+    if (port.receive()) {
+      received = true;
+    }
+  }
+  return received;
+}
+
+qreal TrashModel::speed() { return TRASH_SPEED; }
+
+qreal TrashModel::ratio() { return ratio_; }
+
+CenterModel::CenterModel(int size)
+    : DeviceModel([=]() {
+        QList<QPoint> ret;
+        for (int i = 0; i < size; i++) {
+          for (int j = 0; j < size; j++) {
+            ret.push_back(QPoint(i, j));
+          }
+        }
+        return ret;
+      }()),
+      size(size) {
+  initPorts();
+}
+
+void CenterModel::initPorts() {
+  layout.reserve(4 * size);
+  for (int i = 0; i < size; i++) {
+    layout.push_back({{size - 1, i}, R0});
+  }
+  for (int i = 0; i < size; i++) {
+    layout.push_back({{0, i}, R180});
+  }
+  for (int i = 0; i < size; i++) {
+    layout.push_back({{i, 0}, R90});
+  }
+  for (int i = 0; i < size; i++) {
+    layout.push_back({{i, size - 1}, R270});
+  }
+  in.resize(layout.size());
+  paused.assign(layout.size(), false);
+}
+
+PortRange CenterModel::ports() {
+  return PortRange(this, layout.data(), layout.size());
+}
+
+Port *CenterModel::port(int k) { return &in.at(k); }
+
+void CenterModel::setReceiver(std::function<void(const Item *)> receiver) {
+  this->receiver = receiver;
+}
+
+CenterModel::CenterModel(QDataStream &sin) : DeviceModel(sin) {
+  sin >> size;
+  initPorts();
+}
+
+void CenterModel::save(QDataStream &out) {
+  DeviceModel::save(out);
+  out << size;
+}
+
+void CenterModel::deliver() {
+  if (receiver) {
+    for (auto &[item, input] : received) {
+      receiver(item);
+    }
+  }
+  received.clear();
+}
+bool CenterModel::next() {
+  bool progress = false;
+  for (int k = 0; k < (int)in.size(); k++) {
+    if (paused[k]) {
+      continue;
+    }
+    const Item *item = in[k].receive();
+    if (item) {
+      received.push_back({item, in[k].id()});
+      progress = true;
+    }
+  }
+  return progress;
+}
+
+qreal CenterModel::speed() { return CENTER_SPEED; }
+
+qreal CenterModel::ratio() { return ratio_; }
+
+DeviceFactory::DeviceFactory() {}
+
+MinerFactory::MinerFactory() {}
+
+MinerModel *MinerFactory::createDevice(const QList<QPoint> &blocks,
+                                       const QList<PortHint> &hints,
+                                       ItemFactory *itemFactory) {
+  return new MinerModel(itemFactory);
+}
+
+BeltFactory::BeltFactory() {}
+
+bool operator<(const QPoint &a, const QPoint &b) {
+  if (a.x() != b.x())
+    return a.x() < b.x();
+  return a.y() < b.y();
+}
+
+BeltModel *BeltFactory::createDevice(const QList<QPoint> &blocks,
+                                     const QList<PortHint> &hints,
+                                     ItemFactory *itemFactory) {
+  assert(blocks.size() >= 1);
+  assert(hints.size() == blocks.size());
+  // no overlap or blank check
+  std::set<QPoint> points;
+  if (blocks.size() > 1) {
+    QPoint p = blocks.front();
+    points.insert(p);
+    for (int i = 1; i < blocks.size(); i++) {
+      QPoint np = blocks[i];
+      bool flag = false;
+      for (int k = 0; k < 4; k++) {
+        if (np == p + QPoint(dx[k], dy[k])) {
+          flag = true;
+          break;
+        }
+      }
+      if (!flag)
+        return nullptr;
+      if (points.find(np) != points.end())
+        return nullptr;
+      points.insert(np);
+      p = np;
+    }
+  }
+
+  rotate_t inDirection = R0, outDirection = R0;
+
+  if (blocks.size() > 1) {
+    for (int d = 0; d < 4; d++) {
+      Port *p = hints.front()[rotate_t(d)];
+      if (!p)
+        continue;
+      if (p->kind() == Port::OUTPUT) {
+        inDirection = rotate_t((d + 2) % 4);
+        break;
+      }
+    }
+
+    for (int d = 0; d < 4; d++) {
+      Port *p = hints.back()[rotate_t(d)];
+      if (!p)
+        continue;
+      if (p->kind() == Port::INPUT) {
+        outDirection = rotate_t(d);
+        break;
+      }
+    }
+
+    for (int d = 0; d < 4; d++) {
+      const QPoint &a = blocks[0], &b = blocks[1];
+      if (a + dp[d] == b) {
+        if (inDirection == (d + 2) % 4) {
+          inDirection = rotate_t(d);
+        }
+        break;
+      }
+    }
+
+    for (int d = 0; d < 4; d++) {
+      const QPoint &a = blocks[blocks.size() - 2], &b = blocks.back();
+      if (a + dp[d] == b) {
+        if (outDirection == (d + 2) % 4) {
+          outDirection = rotate_t(d);
+        }
+        break;
+      }
+    }
+  }
+
+  return new BeltModel(blocks, inDirection, outDirection);
+}
+
+TrashFactory::TrashFactory() {}
+
+TrashModel *TrashFactory::createDevice(const QList<QPoint> &blocks,
+                                       const QList<PortHint> &hints,
+                                       ItemFactory *itemFactory) {
+  return new TrashModel();
+}
+
+static DeviceFactory *globalDeviceFactories[] = {new MinerFactory(),
+                                                 new BeltFactory(),
+                                                 new CutterFactory(),
+                                                 new MixerFactory(),
+                                                 new RotatorFactory(),
+                                                 new TrashFactory(),
+                                                 nullptr};
+
+DeviceFactory *getDeviceFactory(device_id_t id) {
+  assert(id < DEV_NONE);
+  if (globalDeviceFactories[id] == nullptr) {
+    qWarning() << "unsupported device id" << id;
+  }
+  return globalDeviceFactories[id];
+}
+
+CutterModel::CutterModel() : DeviceModel({{0, 0}, {0, 1}}), stall(false) {}
+
+qreal CutterModel::ratio_ = 1;
+
+void CutterModel::save(QDataStream &out) {
+  DeviceModel::save(out);
+  out << stall;
+}
+
+PortRange CutterModel::ports() { return PortRange(this, LAYOUT); }
+
+Port *CutterModel::port(int k) {
+  Port *ports[] = {&in, &outU, &outL};
+  return ports[k];
+}
+
+CutterModel::CutterModel(QDataStream &in) : DeviceModel(in) { in >> stall; }
+
+bool CutterModel::next() {
+  if (stall)
+    return false;
+  if (outU.ready() && outL.ready()) {
+    const Item *item = in.receive();
+    if (!item)
+      return false;
+    const Mine *mine = dynamic_cast<const Mine *>(item);
+    if (!mine) {
+      stall = true;
+      return true;
+    }
+    outU.send(mine->cutUpper());
+    outL.send(mine->cutLower());
+    return true;
+  }
+  return false;
+}
+
+qreal CutterModel::speed() { return CUTTER_SPEED; }
+
+qreal CutterModel::ratio() { return ratio_; }
+
+CutterFactory::CutterFactory() {}
+
+CutterModel *CutterFactory::createDevice(const QList<QPoint> &blocks,
+                                         const QList<PortHint> &hints,
+                                         ItemFactory *itemFactory) {
+  return new CutterModel();
+}
+
+RotatorModel::RotatorModel() {}
+
+qreal RotatorModel::ratio_ = 1;
+
+void RotatorModel::save(QDataStream &out) { DeviceModel::save(out); }
+
+PortRange RotatorModel::ports() { return PortRange(this, LAYOUT); }
+
+Port *RotatorModel::port(int k) {
+  assert(k == 0 || k == 1);
+  return k == 0 ? static_cast<Port *>(&in) : &out;
+}
+
+RotatorModel::RotatorModel(QDataStream &in) : DeviceModel(in) {}
+
+bool RotatorModel::next() {
+  if (out.ready()) {
+    auto item = in.receive();
+    if (!item)
+      return false;
+    auto mine = dynamic_cast<const Mine *>(item);
+    if (mine) {
+      out.send(mine->rotateR());
+    } else {
+      out.send(item);
+    }
+    return true;
+  }
+  return false;
+}
+
+qreal RotatorModel::speed() { return ROTATOR_SPEED; }
+
+qreal RotatorModel::ratio() { return ratio_; }
+
+RotatorFactory::RotatorFactory() {}
+
+RotatorModel *RotatorFactory::createDevice(const QList<QPoint> &blocks,
+                                           const QList<PortHint> &hints,
+                                           ItemFactory *itemFactory) {
+  return new RotatorModel();
+}
+
+MixerModel::MixerModel() : DeviceModel({{0, 0}, {1, 0}}), stall(false) {}
+
+qreal MixerModel::ratio_ = 1;
+
+void MixerModel::save(QDataStream &out) {
+  DeviceModel::save(out);
+  out << stall;
+}
+
+PortRange MixerModel::ports() { return PortRange(this, LAYOUT); }
+
+Port *MixerModel::port(int k) {
+  Port *ports[] = {&inMine, &inTrait, &out};
+  return ports[k];
+}
+
+MixerModel::MixerModel(QDataStream &in) : DeviceModel(in) { in >> stall; }
+
+bool MixerModel::next() {
+  if (!(inMine.ready() && inTrait.ready() && out.ready()))
+    return false;
+  const Item *itemMine = inMine.receive();
+  const Item *itemTrait = inTrait.receive();
+  const Mine *mine = dynamic_cast<const Mine *>(itemMine);
+  const TraitMine *trait = dynamic_cast<const TraitMine *>(itemTrait);
+  if (!mine || !trait) {
+    stall = true;
+    return true;
+  }
+
+  out.send(mine->setTrait(trait->getTrait()));
+  return true;
+}
+
+qreal MixerModel::speed() { return MIXER_SPEED; }
+
+qreal MixerModel::ratio() { return ratio_; }
+
+MixerFactory::MixerFactory() {}
+
+MixerModel *MixerFactory::createDevice(const QList<QPoint> &blocks,
+                                       const QList<PortHint> &hints,
+                                       ItemFactory *itemFactory) {
+  return new MixerModel();
+}
+
+// serialize
+void saveDevice(QDataStream &out, DeviceModel *dev) {
+  if (!dev) {
+    out << QChar('N');
+    return;
+  } else if (dynamic_cast<MinerModel *>(dev)) {
+    out << QChar('M');
+  } else if (dynamic_cast<BeltModel *>(dev)) {
+    out << QChar('B');
+  } else if (dynamic_cast<CutterModel *>(dev)) {
+    out << QChar('C');
+  } else if (dynamic_cast<MixerModel *>(dev)) {
+    out << QChar('X');
+  } else if (dynamic_cast<RotatorModel *>(dev)) {
+    out << QChar('R');
+  } else if (dynamic_cast<TrashModel *>(dev)) {
+    out << QChar('T');
+  } else if (dynamic_cast<CenterModel *>(dev)) {
+    out << QChar('A');
+  } else {
+    assert(false);
+  }
+  dev->save(out);
+}
+
+DeviceModel *loadDevice(QDataStream &in) {
+  QChar id;
+  in >> id;
+  if (id == 'N') {
+    return nullptr;
+  } else if (id == 'M') {
+    return new MinerModel(in);
+  } else if (id == 'B') {
+    return new BeltModel(in);
+  } else if (id == 'C') {
+    return new CutterModel(in);
+  } else if (id == 'X') {
+    return new MixerModel(in);
+  } else if (id == 'T') {
+    return new TrashModel(in);
+  } else if (id == 'R') {
+    return new RotatorModel(in);
+  } else if (id == 'A') {
+    return new CenterModel(in);
+  } else {
+    assert(false);
+  }
+  return nullptr;
+}
+
+static int ratioGeneration = 0;
+
+int deviceRatioGeneration() { return ratioGeneration; }
+
+void resetDeviceRatio() {
+  ratioGeneration++;
+  MinerModel::ratio_ = 1;
+  BeltModel::ratio_ = 1;
+  CutterModel::ratio_ = 1;
+  RotatorModel::ratio_ = 1;
+  MixerModel::ratio_ = 1;
+  TrashModel::ratio_ = 1;
+}
+
+void setDeviceRatio(device_id_t id, qreal ratio) {
+  assert(0.5 <= ratio && ratio <= 4);
+  ratioGeneration++;
+  switch (id) {
+  case MINER:
+    MinerModel::ratio_ = ratio;
+    break;
+  case BELT:
+    BeltModel::ratio_ = ratio;
+    break;
+  case CUTTER:
+    CutterModel::ratio_ = ratio;
+    break;
+  case ROTATOR:
+    RotatorModel::ratio_ = ratio;
+    break;
+  case MIXER:
+    MixerModel::ratio_ = ratio;
+    break;
+  case TRASH:
+    TrashModel::ratio_ = ratio;
+    break;
+  default:
+    break;
+  }
+}
+
+qreal getDeviceRatio(device_id_t id) {
+  switch (id) {
+  case MINER:
+    return MinerModel::ratio_;
+  case BELT:
+    return BeltModel::ratio_;
+  case CUTTER:
+    return CutterModel::ratio_;
+  case ROTATOR:
+    return RotatorModel::ratio_;
+  case MIXER:
+    return MixerModel::ratio_;
+  case TRASH:
+    return TrashModel::ratio_;
+  default:
+    assert(false);
+  }
+  return 0;
+}
+
+void restoreDevice(DeviceModel *dev, ItemFactory *f) {
+  if (auto miner = dynamic_cast<MinerModel *>(dev)) {
+    miner->restore(f);
+  }
+}
+
+qreal getDeviceSpeed(device_id_t id) {
+  switch (id) {
+  case MINER:
+    return MinerModel::MINER_SPEED;
+  case BELT:
+    return BeltModel::BELT_SPEED;
+  case CUTTER:
+    return CutterModel::CUTTER_SPEED;
+  case ROTATOR:
+    return RotatorModel::ROTATOR_SPEED;
+  case MIXER:
+    return MixerModel::MIXER_SPEED;
+  case TRASH:
+    return TrashModel::TRASH_SPEED;
+  default:
+    assert(false);
+  }
+  return 0;
+}
+
+void saveDeviceRatio(QDataStream &out) {
+  out << MinerModel::ratio_ << BeltModel::ratio_ << CutterModel::ratio_
+      << RotatorModel::ratio_ << MixerModel::ratio_ << TrashModel::ratio_;
+}
+
+void loadDeviceRatio(QDataStream &in) {
+  ratioGeneration++;
+  in >> MinerModel::ratio_ >> BeltModel::ratio_ >> CutterModel::ratio_ >>
+      RotatorModel::ratio_ >> MixerModel::ratio_ >> TrashModel::ratio_;
+}
+
+const QString getDeviceName(device_id_t id) {
+  switch (id) {
+  case MINER:
+    return "Miner";
+  case BELT:
+    return "Belt";
+  case CUTTER:
+    return "Cutter";
+  case ROTATOR:
+    return "Rotator";
+  case MIXER:
+    return "Mixer";
+  case TRASH:
+    return "Trash";
+  default:
+    return "";
+  }
+  return "";
+}
@@ -0,0 +1,539 @@
+#ifndef DEVICEMODEL_H
+#define DEVICEMODEL_H
+
+#include "devicepool.h"
+#include "port.h"
+#include "scheduler.h"
+#include "slotmap.h"
+#include <QtCore>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+enum device_id_t { MINER, BELT, CUTTER, MIXER, ROTATOR, TRASH, DEV_NONE };
+
+class DeviceModel;
+
+// Where a port of a device is before the device is rotated: its block and the
+// side it faces. Each device type lists its ports in a constexpr table of
+// these; entry k is the port returned by DeviceModel::port(k).
+struct PortLayout {
+  QPoint block;
+  rotate_t side;
+};
+
+struct PortEntry {
+  Port *port;
+  QPoint block;
+  rotate_t side;
+};
+
+// The ports of a device, read from its layout table as they are visited, so
+// listing them allocates nothing.
+class PortRange {
+public:
+  explicit PortRange() : device(nullptr), layout(nullptr), size_(0) {}
+  explicit PortRange(DeviceModel *device, const PortLayout *layout, int size)
+      : device(device), layout(layout), size_(size) {}
+  template <size_t N>
+  explicit PortRange(DeviceModel *device, const PortLayout (&layout)[N])
+      : PortRange(device, layout, int(N)) {}
+
+  class iterator {
+  public:
+    PortEntry operator*() const;
+    iterator &operator++() {
+      k++;
+      return *this;
+    }
+    bool operator!=(const iterator &o) const { return k != o.k; }
+
+  private:
+    friend class PortRange;
+    explicit iterator(const PortRange *range, int k) : range(range), k(k) {}
+    const PortRange *range;
+    int k;
+  };
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, size_); }
+  int size() const { return size_; }
+
+private:
+  DeviceModel *device;
+  const PortLayout *layout;
+  int size_;
+};
+
+// Simulation side of a device: ports, buffers and tick logic, no painting.
+// The GUI classes in device.h are views over these.
+class DeviceModel {
+public:
+  explicit DeviceModel(
+      const QList<QPoint> &blocks = QList<QPoint>({QPoint(0, 0)}));
+  virtual ~DeviceModel();
+  const QList<QPoint> &blocks() const;
+  SlotId id() const; // in Simulation::devices(), while installed
+  virtual PortRange ports() = 0;
+  virtual Port *port(int k) = 0; // entry k of ports()
+
+  // port events of a sleeping device, see Scheduler
+  virtual void wake();
+
+  // serialize
+  explicit DeviceModel(QDataStream &in);
+  virtual void save(QDataStream &out); // all devices must save DeviceModel
+                                       // first (call this function)
+
+protected:
+  // timing
+  // next() will be called speed() * ratio() times in one sec, it returns
+  // whether it changed anything
+  virtual bool next() = 0;
+  virtual qreal speed() = 0;
+  virtual qreal ratio() = 0;
+
+private:
+  QList<QPoint> blocks_;
+  int frameCount; // frames since the last next(), kept by Scheduler::sync()
+
+  friend class Throughput; // reads the rates
+
+  friend class Simulation; // sets the id
+  SlotId id_;
+
+  // scheduling, maintained by Scheduler
+  friend class Scheduler;
+  Scheduler *scheduler;
+  qint64 interval; // time between two next() calls, see Scheduler
+  qint64 due;      // time of the next next() call
+  std::vector<DeviceModel *> *slot; // timing wheel bucket, nullptr asleep
+  int slotIndex;
+};
+
+inline PortEntry PortRange::iterator::operator*() const {
+  const PortLayout &l = range->layout[k];
+  return {range->device->port(k), l.block, l.side};
+}
+
+class DeviceFactory {
+public:
+  explicit DeviceFactory();
+  virtual DeviceModel *createDevice(const QList<QPoint> &blocks,
+                                    const QList<PortHint> &hints,
+                                    ItemFactory *itemFactory = nullptr) = 0;
+};
+
+DeviceFactory *getDeviceFactory(device_id_t id);
+
+class MinerModel : public DeviceModel, public Pooled<MinerModel> {
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit MinerModel(ItemFactory *factory);
+  PortRange ports() override;
+  Port *port(int k) override;
+
+  // serialize
+  explicit MinerModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  void restore(ItemFactory *f);
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  static constexpr qreal MINER_SPEED = 0.5; // 0.5 items / sec
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  friend class Throughput;
+  static constexpr PortLayout LAYOUT[] = {{QPoint(0, 0), R0}};
+  ItemFactory *factory;
+  OutputPort out;
+};
+
+class MinerFactory : public DeviceFactory {
+public:
+  explicit MinerFactory();
+
+  // DeviceFactory interface
+  MinerModel *createDevice(const QList<QPoint> &blocks,
+                           const QList<PortHint> &hints,
+                           ItemFactory *itemFactory) override;
+};
+
+class BeltPath;
+
+class BeltModel : public DeviceModel, public Pooled<BeltModel> {
+  friend class BeltPath;
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit BeltModel(const QList<QPoint> &blocks, rotate_t inDirection,
+                     rotate_t outDirection);
+  ~BeltModel();
+  PortRange ports() override;
+  Port *port(int k) override;
+  void wake() override; // wakes the head of the path
+
+  enum turn_t { PASS_THROUGH, TURN_LEFT, TURN_RIGHT };
+
+  // paths, called by Simulation at the end of a batch of edits, once the
+  // ports are connected and disconnected: the removed belts end up alone,
+  // the rest of their paths and the installed belts join their neighbours
+  static void editPaths(const std::vector<BeltModel *> &removed,
+                        const std::vector<BeltModel *> &installed);
+
+  // state for the view
+  const BeltPath *getPath() const;
+  int length() const;
+  rotate_t direction(int block) const;
+  turn_t turn(int block) const;
+  // the items on this segment, positions relative to its first block
+  QList<QPair<const Item *, int>> items() const;
+  const Item *outBuffer();
+  // next() calls per item on a belt that is full
+  static int callsPerItem();
+
+  // serialize
+  explicit BeltModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  // Belt has unique refreshing logic, so its BELT_SPEED means BELT_SPEED *
+  // ratio() * 0.1 blocks on the belt per sec
+  static constexpr qreal BELT_SPEED = 15; // beginning at 1.5 blocks per second
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  InputPort in;
+  OutputPort out;
+  // the ends of the belt, set by the constructors
+  PortLayout layout[2];
+
+  rotate_t inDirection, outDirection;
+  std::vector<rotate_t> direction_;
+  std::vector<turn_t> turn_;
+  int length_;
+
+  BeltPath *path;
+  int offset; // blocks of the path before this segment
+};
+
+// Belt segments joined out to in share one BeltPath: a single item queue
+// over all of them, moved by the head segment's next(). The other segments
+// only hold blocks and ports; their joints never buffer an item.
+class BeltPath {
+  friend class BeltModel;
+public:
+  explicit BeltPath(BeltModel *belt);
+  BeltModel *head() const;
+  BeltModel *tail() const;
+  int length() const; // blocks
+  bool next();
+  // changes whenever the items or the segments do and never repeats, so a
+  // copy of the items can tell whether it is still current
+  quint64 stamp() const;
+  // the items on each segment, positions relative to its first block, in one
+  // pass over the path
+  std::vector<std::pair<BeltModel *, QList<QPair<const Item *, int>>>>
+  segmentItems() const;
+
+  // merges every path of belts with the paths up and down of it, a whole
+  // chain at once
+  static void join(const std::vector<BeltModel *> &belts);
+  // splits path around the segments in gone, which end up alone; the runs
+  // of segments between them keep their items and become paths, whose heads
+  // are returned. path is deleted.
+  static std::vector<BeltModel *>
+  split(BeltPath *path, const std::unordered_set<BeltModel *> &gone);
+
+private:
+  typedef QList<QPair<const Item *, int>> positions_t;
+  explicit BeltPath(const QList<BeltModel *> &segments,
+                    const positions_t &items);
+  void adopt(); // points the segments at this path
+  // (item, position along the whole path), the front is farthest along
+  positions_t positions() const;
+  void assign(const positions_t &items);
+  BeltPath *up() const; // the path feeding the head, nullptr for none
+  BeltPath *down() const;
+  // appends the others to the first, each one feeding the next, and deletes
+  // them; the same as merging them one by one from the last, in one pass
+  static void merge(const std::vector<BeltPath *> &chain);
+
+  QList<BeltModel *> segments;
+  int length_;
+
+  // The items are stored as the gaps between them: gaps[i] is the distance
+  // from items[i] to items[i + 1]. No gap is ever below 0.9 L, so once an
+  // item moves every item behind it moves too, and a step only changes the
+  // gap in front of the first item that moves. Gaps never grow, so the first
+  // one loose enough to close only moves backwards (firstLoose).
+  QQueue<const Item *> items;
+  QQueue<int> gaps;
+  int headPos, tailPos; // positions of the front and the back item
+  int firstLoose;       // gaps before it are too tight to close
+
+  quint64 stamp_;
+  static std::atomic<quint64> nextStamp; // paths tick on several threads
+};
+
+class BeltFactory : public DeviceFactory {
+public:
+  explicit BeltFactory();
+
+  // DeviceFactory interface
+  BeltModel *createDevice(const QList<QPoint> &blocks,
+                          const QList<PortHint> &hints,
+                          ItemFactory *itemFactory) override;
+};
+
+class CutterModel : public DeviceModel, public Pooled<CutterModel> {
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit CutterModel();
+  PortRange ports() override;
+  Port *port(int k) override;
+
+  // serialize
+  explicit CutterModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  static constexpr qreal CUTTER_SPEED = 0.25;
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  friend class Throughput;
+  static constexpr PortLayout LAYOUT[] = {
+      {QPoint(0, 0), R180}, // in
+      {QPoint(0, 0), R0},   // outU
+      {QPoint(0, 1), R0},   // outL
+  };
+  InputPort in;
+  OutputPort outU, outL;
+
+  bool stall;
+};
+
+class CutterFactory : public DeviceFactory {
+public:
+  explicit CutterFactory();
+
+  // DeviceFactory interface
+  CutterModel *createDevice(const QList<QPoint> &blocks,
+                            const QList<PortHint> &hints,
+                            ItemFactory *itemFactory) override;
+};
+
+class RotatorModel : public DeviceModel, public Pooled<RotatorModel> {
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit RotatorModel();
+  PortRange ports() override;
+  Port *port(int k) override;
+
+  // serialize
+  explicit RotatorModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  static constexpr qreal ROTATOR_SPEED = 0.65;
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  static constexpr PortLayout LAYOUT[] = {
+      {QPoint(0, 0), R180}, // in
+      {QPoint(0, 0), R0},   // out
+  };
+  InputPort in;
+  OutputPort out;
+};
+
+class RotatorFactory : public DeviceFactory {
+public:
+  explicit RotatorFactory();
+
+  // DeviceFactory interface
+  RotatorModel *createDevice(const QList<QPoint> &blocks,
+                             const QList<PortHint> &hints,
+                             ItemFactory *itemFactory) override;
+};
+
+class MixerModel : public DeviceModel, public Pooled<MixerModel> {
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit MixerModel();
+  PortRange ports() override;
+  Port *port(int k) override;
+
+  // serialize
+  explicit MixerModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  static constexpr qreal MIXER_SPEED = 0.25;
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  friend class Throughput;
+  static constexpr PortLayout LAYOUT[] = {
+      {QPoint(0, 0), R180}, // inMine
+      {QPoint(1, 0), R90},  // inTrait
+      {QPoint(1, 0), R0},   // out
+  };
+  InputPort inMine, inTrait;
+  OutputPort out;
+  bool stall;
+};
+
+class MixerFactory : public DeviceFactory {
+public:
+  explicit MixerFactory();
+
+  // DeviceFactory interface
+  MixerModel *createDevice(const QList<QPoint> &blocks,
+                           const QList<PortHint> &hints,
+                           ItemFactory *itemFactory) override;
+};
+
+class TrashModel : public DeviceModel, public Pooled<TrashModel> {
+  friend qreal getDeviceRatio(device_id_t id);
+  friend qreal getDeviceSpeed(device_id_t id);
+  friend void setDeviceRatio(device_id_t id, qreal ratio);
+  friend void resetDeviceRatio();
+public:
+  explicit TrashModel();
+  PortRange ports() override;
+  Port *port(int k) override;
+
+  // serialize
+  explicit TrashModel(QDataStream &in);
+  void save(QDataStream &out) override;
+  friend void saveDeviceRatio(QDataStream &out);
+  friend void loadDeviceRatio(QDataStream &in);
+
+protected:
+  // timing
+  static constexpr qreal TRASH_SPEED = 1;
+  static qreal ratio_;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  static constexpr PortLayout LAYOUT[] = {
+      {QPoint(0, 0), R0},
+      {QPoint(0, 0), R90},
+      {QPoint(0, 0), R180},
+      {QPoint(0, 0), R270},
+  };
+  std::array<InputPort, 4> in; // in LAYOUT order
+};
+
+class TrashFactory : public DeviceFactory {
+public:
+  explicit TrashFactory();
+
+  // DeviceFactory interface
+  TrashModel *createDevice(const QList<QPoint> &blocks,
+                           const QList<PortHint> &hints,
+                           ItemFactory *itemFactory) override;
+};
+
+class CenterModel : public DeviceModel {
+public:
+  explicit CenterModel(int size);
+  PortRange ports() override;
+  Port *port(int k) override;
+  // every received item is handed to the receiver by deliver(), which the
+  // Simulation calls after the frame, on its own thread
+  void setReceiver(std::function<void(const Item *)> receiver);
+  void deliver();
+
+  // serialize
+  explicit CenterModel(QDataStream &in);
+  void save(QDataStream &out) override;
+
+protected:
+  // timing
+  static constexpr qreal CENTER_SPEED = 10;
+  static constexpr qreal ratio_ = 1;
+  bool next() override;
+  qreal speed() override;
+  qreal ratio() override;
+
+private:
+  void initPorts();
+
+  int size;
+  // the layout depends on the size, so it is built with the ports, once
+  std::vector<PortLayout> layout;
+  std::vector<InputPort> in; // in layout order
+  // by in, the inputs of lines SteadyState has frozen are not taken from
+  std::vector<char> paused;
+  std::function<void(const Item *)> receiver;
+  // this frame, with the input id; -1 for items credited by SteadyState
+  QList<QPair<const Item *, int>> received;
+  friend class SteadyState;
+};
+
+const QString getDeviceName(device_id_t id);
+
+// serialize
+void saveDevice(QDataStream &out, DeviceModel *dev);
+DeviceModel *loadDevice(QDataStream &in);
+void restoreDevice(DeviceModel *dev, ItemFactory *itemFactory);
+void saveDeviceRatio(QDataStream &out);
+void loadDeviceRatio(QDataStream &in);
+// timing
+void resetDeviceRatio();
+int deviceRatioGeneration(); // changes whenever any ratio changes
+void setDeviceRatio(device_id_t id, qreal ratio);
+qreal getDeviceRatio(device_id_t id);
+qreal getDeviceSpeed(device_id_t id); // next() calls per sec at ratio 1
+
+#endif // DEVICEMODEL_H
@@ -0,0 +1,55 @@
+#ifndef DEVICEPOOL_H
+#define DEVICEPOOL_H
+
+#include <cassert>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Dense storage for the devices of one type: objects are placed in chunks of
+// CHUNK_SIZE slots, so all Miners (or all Cutters, ...) sit next to each
+// other and the scheduler walks them in memory order. Slots never move, the
+// port graph keeps pointing into them; freed slots are reused first.
+template <class T> class DevicePool {
+public:
+  static void *allocate() {
+    auto &pool = instance();
+    if (pool.freeSlots.empty()) {
+      pool.chunks.emplace_back(new Chunk);
+      for (int i = CHUNK_SIZE - 1; i >= 0; i--) {
+        pool.freeSlots.push_back(pool.chunks.back()->storage[i]);
+      }
+    }
+    void *slot = pool.freeSlots.back();
+    pool.freeSlots.pop_back();
+    return slot;
+  }
+
+  static void release(void *slot) { instance().freeSlots.push_back(slot); }
+
+private:
+  static constexpr int CHUNK_SIZE = 256;
+  struct Chunk {
+    alignas(T) unsigned char storage[CHUNK_SIZE][sizeof(T)];
+  };
+
+  static DevicePool &instance() {
+    static DevicePool pool;
+    return pool;
+  }
+
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  std::vector<void *> freeSlots;
+};
+
+// Derive a device class from Pooled<itself> to allocate it from its pool.
+template <class T> class Pooled {
+public:
+  static void *operator new(size_t size) {
+    assert(size == sizeof(T));
+    return DevicePool<T>::allocate();
+  }
+  static void operator delete(void *p) { DevicePool<T>::release(p); }
+};
+
+#endif // DEVICEPOOL_H
@@ -1,64 +1,68 @@
 #include "gamestate.h"
 
 GameState::GameState(int w, int h, Scene *&scene, GoalManager *&goal, QMainWindow *parent)
-    : QWidget(parent), window(parent), w(w), h(h), money(0), enhance(0), deviceId(DEV_NONE),
+    : QWidget(parent), window(parent), money(0), enhance(0), deviceId(DEV_NONE),
       selector(new Selector(this)), base(QPoint(0, 0)), offset(QPoint(0, 0)),
       rotate(R0), selectorState(false), pause_(false), deviceFactory(nullptr),
-      moneyRatio(1), itemRatio(0.2), nextW(w), nextH(h) {
+      moneyRatio(1), itemRatio(0.2), nextW(w), nextH(h), speed(0),
+      fastForward(false), savedAt(0) {
   assert(window);
   assert(selector);
   assert(w >= 8 && h >= 8);
 
-  scene = new Scene(w, h, *this, parent);
-  this->scene = scene;
-
-  scene->addItem(selector);
-  selector->setZValue(1000);
-  selector->setPos(L / 2, L / 2);
-  scene->installEventFilter(this);
-
-  naiveInitMap(w, h);
-
-  center = new Center(4);
-  QPoint centerBase = {rng.bounded(w - 4), rng.bounded(h - 4)};
-  rotate_t centerRotate = R0;
-  installDevice(centerBase, centerRotate, center);
-  resetDeviceRatio();
+  simulation = new Simulation(w, h, itemRatio);
+  initScene(scene, parent);
 
   goalManager = new GoalManager();
   goal = goalManager;
 }
 
-void GameState::save(QDataStream &out) {
-  out << w << h;
-
-  for (int i = 0; i < w; i++) {
-    for (int j = 0; j < h; j++) {
-      saveItemFactory(out, groundMap(i, j));
-    }
-  }
-
-  out << (int)devices.size();
-  for (auto &[p, desc] : devices) {
-    out << desc.p << desc.r;
-    saveDevice(out, p);
-  }
-  saveDeviceRatio(out);
+GameState::~GameState() {
+  simThread->stop();
+  simulation->setRemoveHook(nullptr);
+  delete simulation;
+}
 
-  goalManager->save(out);
+void GameState::save(QDataStream &out) {
+  // the goals are advanced by the simulation thread
+  simThread->call([this, &out](Simulation &sim) {
+    sim.save(out);
+    goalManager->save(out);
+  });
+  // credit from items delivered before the save
+  QCoreApplication::sendPostedEvents(this);
   out << money << enhance;
 
   out << moneyRatio << itemRatio << nextW << nextH;
+  out << QDateTime::currentSecsSinceEpoch();
 }
 
-void GameState::pause(bool paused) { this->pause_ = paused; }
+void GameState::pause(bool paused) {
+  this->pause_ = paused;
+  simThread->setPaused(paused);
+}
 
 GameState::GameState(QDataStream &in, Scene *&scene, GoalManager *&goal, QMainWindow *parent)
     : QWidget(parent), window(parent), selector(new Selector(this)), base(QPoint(0, 0)), offset(QPoint(0, 0)), deviceId(DEV_NONE),
       rotate(R0), selectorState(false), pause_(false), deviceFactory(nullptr),
-      center(nullptr) {
-  loadMap(in);
-  scene = new Scene(w, h, *this, parent);
+      center(nullptr), speed(0), fastForward(false), savedAt(0) {
+  simulation = new Simulation(in);
+  initScene(scene, parent);
+
+  goalManager = new GoalManager(in);
+  goal = goalManager;
+
+  in >> money >> enhance;
+
+  in >> moneyRatio >> itemRatio >> nextW >> nextH;
+  // saves written before the timestamp end here
+  if (!in.atEnd()) {
+    in >> savedAt;
+  }
+}
+
+void GameState::initScene(Scene *&scene, QMainWindow *parent) {
+  scene = new Scene(*this, parent);
   this->scene = scene;
 
   scene->addItem(selector);
@@ -66,49 +70,129 @@ GameState::GameState(QDataStream &in, Scene *&scene, GoalManager *&goal, QMainWi
   selector->setPos(L / 2, L / 2);
   scene->installEventFilter(this);
 
-  int nr_device;
-  in >> nr_device;
-  // sanity check
-  assert(nr_device >= 0);
-  assert(devices.empty());
-
-  for (int i = 0; i < nr_device; i++) {
-    QPoint base;
-    rotate_t rotate;
-    in >> base >> rotate;
-//    qDebug() << "Loading device at" << base << rotate;
-    Device *dev = loadDevice(in);
+  simThread = new SimThread(
+      simulation, [this](Snapshot &snapshot) { capture(snapshot); }, this);
+  // the thread is not running yet, everything below happens right away
+  simulation->setRemoveHook([this](DeviceModel *model) { removeView(model); });
+  for (auto &[model, desc] : simulation->devices()) {
+    addView(*simulation, model);
+  }
+  flushViews();
+  copyMap(*simulation);
+  center = static_cast<Center *>(views.at(simulation->center()->id().key()));
+}
 
-    devices.insert({dev, {base, rotate}});
+void GameState::gui(std::function<void()> f) {
+  if (QThread::currentThread() == thread()) {
+    f();
+  } else {
+    QMetaObject::invokeMethod(this, f, Qt::QueuedConnection);
   }
+}
 
-  for (auto &[dev, desc] : devices) {
-    assert(dev);
-    if (Center *c = dynamic_cast<Center *>(dev)) {
-      center = c;
-    }
-    installDevice(desc.p, desc.r, dev);
-    restoreDevice(dev, groundMap(desc.p));
+void GameState::addView(Simulation &sim, DeviceModel *model) {
+  const DeviceDescription &desc = sim.description(model);
+  // the view copies what it paints from the model, see Device
+  Device *view = createDeviceView(model);
+  view->setPos(desc.p.x() * L + L / 2, desc.p.y() * L + L / 2);
+  view->setRotation(-desc.r * 90);
+  view->moveToThread(thread());
+
+  quint64 serial = model->id().key();
+  if (auto belt = dynamic_cast<BeltModel *>(model)) {
+    belts.insert({serial, belt});
   }
-  loadDeviceRatio(in);
+  viewEdits.push_back({serial, view});
+}
 
-  assert(center);
+void GameState::removeView(DeviceModel *model) {
+  // off the map already, but not deleted yet, so its id still reads
+  quint64 serial = model->id().key();
+  belts.erase(serial);
+  viewEdits.push_back({serial, nullptr});
+}
 
-  goalManager = new GoalManager(in);
-  goal = goalManager;
+void GameState::flushViews() {
+  if (viewEdits.empty()) {
+    return;
+  }
+  std::vector<std::pair<quint64, Device *>> edits;
+  edits.swap(viewEdits);
+  gui([this, edits] {
+    for (auto &[serial, view] : edits) {
+      if (view) {
+        showView(serial, view);
+      } else {
+        hideView(serial);
+      }
+    }
+  });
+}
+
+void GameState::copyMap(Simulation &sim) {
+  int w = sim.width(), h = sim.height();
+  Ground ground = sim.ground();
+  gui([this, w, h, ground] {
+    mapW = w;
+    mapH = h;
+    this->ground = ground;
+  });
+}
+
+void GameState::capture(Snapshot &snapshot) {
+  // the snapshot was last filled a few frames ago: a path that has not
+  // changed since keeps its items, the others are listed once for all of
+  // their segments
+  for (auto it = snapshot.belts.begin(); it != snapshot.belts.end();) {
+    it = belts.count(it->first) ? std::next(it) : snapshot.belts.erase(it);
+  }
+  for (auto &[serial, belt] : belts) {
+    BeltState &state = snapshot.belts[serial];
+    state.outBuffer = belt->outBuffer();
+    const BeltPath *path = belt->getPath();
+    if (path->head() != belt || state.stamp == path->stamp()) {
+      continue;
+    }
+    for (auto &[segment, items] : path->segmentItems()) {
+      BeltState &segmentState = snapshot.belts[segment->id().key()];
+      segmentState.items = items;
+      segmentState.stamp = path->stamp();
+    }
+  }
+}
 
-  in >> money >> enhance;
+void GameState::showView(quint64 serial, Device *view) {
+  scene->addItem(view);
+  views.insert({serial, view});
+}
 
-  in >> moneyRatio >> itemRatio >> nextW >> nextH;
+void GameState::hideView(quint64 serial) {
+  auto it = views.find(serial);
+  if (it == views.end()) {
+    return;
+  }
+  Device *view = it->second;
+  views.erase(it);
+  scene->removeItem(view);
+  if (view == center) {
+    center = nullptr;
+  }
+  delete view;
 }
 
 void GameState::init()
 {
-  connect(center, &Center::receiveItem, goalManager, &GoalManager::receiveItem);
+  // goals advance on the simulation thread, their signals are queued to the
+  // GUI
+  qRegisterMetaType<const Item *>("const Item *");
+  simulation->center()->setReceiver(
+      [this](const Item *item) { goalManager->receiveItem(item); });
   connect(goalManager, &GoalManager::updateGoal, center, &Center::updateGoal);
   connect(goalManager, &GoalManager::enhanceChange, this, &GameState::enhanceChange);
   connect(goalManager, &GoalManager::moneyChange, this, &GameState::moneyChange);
-  connect(goalManager, &GoalManager::mapConstructEvent, this, &GameState::mapConstructEvent);
+  // the map is rebuilt outside of Simulation::advance(), which delivered the item
+  connect(goalManager, &GoalManager::mapConstructEvent, this,
+          &GameState::mapConstructEvent, Qt::QueuedConnection);
 
   goalManager->init();
 
@@ -118,32 +202,14 @@ void GameState::init()
     emit deviceRatioChangeEvent(device_id_t(i), getDeviceRatio(device_id_t(i)));
   }
 
-  timerId = startTimer(1000 / FPS);
-}
-
-void GameState::loadMap(QDataStream &in) {
-  in >> w >> h;
-
-  groundMap_.resize(w);
-  for (auto &col : groundMap_) {
-    col.resize(h);
-  }
-
-  deviceMap_.resize(w);
-  for (auto &col : deviceMap_) {
-    col.resize(h);
-  }
+  emit speedChangeEvent(SPEEDS[speed]);
 
-  portMap_.resize(w);
-  for (auto &col : portMap_) {
-    col.resize(h);
-  }
+  creditOffline();
 
-  for (int i = 0; i < w; i++) {
-    for (int j = 0; j < h; j++) {
-      groundMap_[i][j] = loadItemFactory(in);
-    }
-  }
+  simThread->setPaused(pause_);
+  simThread->start();
+  // repaint from the snapshots
+  timerId = startTimer(1000 / FPS);
 }
 
 bool GameState::enhanceDevice(device_id_t id)
@@ -151,136 +217,76 @@ bool GameState::enhanceDevice(device_id_t id)
   if (enhance <= 0) {
     return false;
   }
-  qreal ratio = getDeviceRatio(id), nr;
-  if (abs(ratio - 1) < EPS) {
-    nr = 1.5;
-  } else if (abs(ratio - 1.5) < EPS) {
-    nr = 2;
-  } else if (abs(ratio - 2) < EPS) {
-    nr = 2.5;
-  } else if (abs(ratio - 2.5) < EPS) {
-    nr = 3;
-  } else {
-    return false;
-  }
-  setDeviceRatio(id, nr);
+  // the ratios are read by the simulation thread, so they are changed there;
+  // the enhancement is given back if the device is at its last level
   enhance --;
   emit enhanceChangeEvent(enhance);
-  emit deviceRatioChangeEvent(id, nr);
+  simThread->post([this, id](Simulation &) {
+    qreal ratio = getDeviceRatio(id), nr;
+    if (abs(ratio - 1) < EPS) {
+      nr = 1.5;
+    } else if (abs(ratio - 1.5) < EPS) {
+      nr = 2;
+    } else if (abs(ratio - 2) < EPS) {
+      nr = 2.5;
+    } else if (abs(ratio - 2.5) < EPS) {
+      nr = 3;
+    } else {
+      gui([this] {
+        enhance ++;
+        emit enhanceChangeEvent(enhance);
+      });
+      return;
+    }
+    setDeviceRatio(id, nr);
+    gui([this, id, nr] { emit deviceRatioChangeEvent(id, nr); });
+  });
   return true;
 }
 
-bool GameState::installDevice(QPoint base, rotate_t rotate, Device *device) {
+bool GameState::installDevice(Simulation &sim, QPoint base, rotate_t rotate,
+                              DeviceModel *device) {
   assert(device);
-  auto blocks = device->blocks();
-  auto portEntries = device->ports();
-
-  // check bound
-  for (auto &block : blocks) {
-    auto p = mapToMap(block, base, rotate);
-    if (!inRange(p)) {
-      return false;
-    }
-    if (dynamic_cast<Center *>(deviceMap(p))) {
-      return false;
-    }
-  }
-
-  // allocating blocks
-  for (auto &block : blocks) {
-    auto p = mapToMap(block, base, rotate);
-
-    auto &d = deviceMap(p);
-    if (d) {
-      removeDevice(d);
-    }
-    d = device;
-  }
-
-  // connecting ports
-  for (auto &e : portEntries) {
-    Port *port = e.first;
-    const auto &[block, portRotate] = e.second;
-
-    rotate_t r = rotate_t((rotate + portRotate) % 4);
-    auto p = mapToMap(block, base, rotate);
-
-    auto &portSlot = portMap(p, r);
-    assert(portSlot == nullptr);
-    portSlot = port;
-
-    Port *op = otherPort(p, r);
-    if (op) {
-      port->connect(op);
-      op->connect(port);
-    }
+  if (!sim.installDevice(base, rotate, device)) {
+    delete device;
+    return false;
   }
 
   // add to gui
-  scene->addItem(device);
-  device->setPos(base.x() * L + L / 2, base.y() * L + L / 2);
-  device->setRotation(-rotate * 90);
-
-  devices.insert({device, {base, rotate}});
+  addView(sim, device);
   return true;
 }
 
-void GameState::removeDevice(Device *device) {
-  assert(devices.find(device) != devices.end());
-//  if (dynamic_cast<Center *>(device)) {
-//    return; // center is not removable
-//  }
-  const auto &[base, rotate] = devices.at(device);
-  auto blocks = device->blocks();
-  auto portEntries = device->ports();
-
-  // disconnecting ports
-  for (auto &e : portEntries) {
-    Port *port = e.first;
-    auto &[block, portRotate] = e.second;
-
-    rotate_t r = rotate_t((rotate + portRotate) % 4);
-    auto p = mapToMap(block, base, rotate);
-
-    auto &portSlot = portMap(p, r);
-    assert(portSlot);
-    portSlot = nullptr;
-
-    Port *op = otherPort(p, r);
-    port->disconnect();
-    if (op) {
-      op->disconnect();
+void GameState::removeDevice(int x, int y) {
+  simThread->post([x, y](Simulation &sim) {
+    DeviceModel *d = sim.deviceAt(QPoint(x, y));
+    if (dynamic_cast<CenterModel *>(d)) {
+      return;
     }
-  }
-
-  // freeing blocks
-  for (auto &block : blocks) {
-    auto p = mapToMap(block, base, rotate);
-    assert(inRange(p));
-
-    auto &d = deviceMap(p);
-    d = nullptr;
-  }
-
-  // remove from gui
-  // device is automatically deleted by Qt
-  scene->removeItem(device);
-
-  devices.erase(device);
+    if (d) {
+      sim.removeDevice(d);
+      flushViews();
+    }
+  });
 }
 
-void GameState::removeDevice(int x, int y) {
-  Device *d = deviceMap(x, y);
-  if (dynamic_cast<Center *>(d)) {
-    return;
-  }
-  if (d) {
-    removeDevice(d);
+void GameState::removeDevice(QPoint p) { removeDevice(p.x(), p.y()); }
+
+void GameState::clearSelection() {
+  QRect rect;
+  for (auto &block : selector->path()) {
+    QPoint p = Simulation::mapToMap(block, base, rotate);
+    rect |= QRect(p, p);
   }
+  selectorState = false;
+  selector->clear();
+  // one batch, see Simulation::beginEdit()
+  simThread->post([this, rect](Simulation &sim) {
+    sim.clear(rect);
+    flushViews();
+  });
 }
 
-void GameState::removeDevice(QPoint p) { removeDevice(p.x(), p.y()); }
-
 void GameState::changeDevice(device_id_t id) {
   DeviceFactory *nf = getDeviceFactory(id);
   if (nf == deviceFactory) {
@@ -294,59 +300,37 @@ void GameState::changeDevice(device_id_t id) {
   }
 }
 
-bool GameState::inRange(int x, int y) {
-  return 0 <= x && x < w && 0 <= y && y < h;
-}
-
-bool GameState::inRange(QPoint p) { return inRange(p.x(), p.y()); }
-
-QPoint GameState::mapToMap(QPoint p, QPoint base, rotate_t rotate) {
-  int bx = base.x(), by = base.y();
-  int x = p.x(), y = p.y();
-  switch (rotate) {
-  case R0:
-    return base + p;
-  case R90:
-    return QPoint(bx + y, by - x);
-  case R180:
-    return base - p;
-  case R270:
-    return QPoint(bx - y, by + x);
+void GameState::stepSpeed(int step) {
+  speed = qBound(0, speed + step, int(SPEEDS.size()) - 1);
+  if (fastForward) {
+    leaveFastForward();
   }
-  assert(false);
-}
-
-ItemFactory *&GameState::groundMap(int x, int y) { return groundMap_[x][y]; }
-
-ItemFactory *&GameState::groundMap(QPoint p) {
-  return groundMap_[p.x()][p.y()];
+  simThread->setSpeed(SPEEDS[speed]);
+  emit speedChangeEvent(SPEEDS[speed]);
 }
 
-Device *&GameState::deviceMap(int x, int y) { return deviceMap_[x][y]; }
-
-Device *&GameState::deviceMap(QPoint p) { return deviceMap_[p.x()][p.y()]; }
-
-Port *&GameState::portMap(int x, int y, rotate_t r) {
-  return portMap_[x][y][r];
-}
-
-Port *&GameState::portMap(QPoint p, rotate_t r) {
-  return portMap_[p.x()][p.y()][r];
-}
-
-Port *GameState::otherPort(QPoint p, rotate_t r) {
-  int nx = p.x() + dx[r], ny = p.y() + dy[r];
-  rotate_t nr = rotate_t((r + 2) % 4);
-  if (!inRange(nx, ny)) {
-    return nullptr;
+void GameState::toggleFastForward() {
+  if (fastForward) {
+    leaveFastForward();
+  } else {
+    fastForward = true;
+    // nothing is painted while fast-forwarding, settled lines can be frozen
+    simThread->post([](Simulation &sim) { sim.setSteadyState(true); });
   }
+  int s = fastForward ? 0 : SPEEDS[speed];
+  simThread->setSpeed(s);
+  emit speedChangeEvent(s);
+}
 
-  return portMap(nx, ny, nr);
+void GameState::leaveFastForward() {
+  fastForward = false;
+  // frozen belts would be painted standing still
+  simThread->post([](Simulation &sim) { sim.setSteadyState(false); });
 }
 
 void GameState::moveSelector(rotate_t d) {
   QPoint cur_p = base + offset, np = cur_p + QPoint(dx[d], dy[d]);
-  if (!inRange(np)) {
+  if (!inMap(np)) {
     return;
   }
   offset += QPoint(dx[d], dy[d]);
@@ -354,9 +338,9 @@ void GameState::moveSelector(rotate_t d) {
 }
 
 void GameState::shiftSelector(rotate_t d) {
-  assert(inRange(base));
+  assert(inMap(base));
   int nx = base.x() + dx[d], ny = base.y() + dy[d];
-  if (!inRange(nx, ny)) {
+  if (!inMap(nx, ny)) {
     return;
   }
 
@@ -365,71 +349,11 @@ void GameState::shiftSelector(rotate_t d) {
   selector->ensureVisible();
 }
 
-QList<PortHint> GameState::getPortHint(QPoint base, rotate_t rotate,
-                                       const QList<QPoint> &blocks) {
-  QList<PortHint> hints;
-  for (auto p : blocks) {
-    std::array<Port *, 4> ports = {};
-    // cpp grammar check
-    assert(ports[0] == nullptr);
-    assert(ports[1] == nullptr);
-    assert(ports[2] == nullptr);
-    assert(ports[3] == nullptr);
-
-    QPoint realp = mapToMap(p, base, rotate);
-
-    for (int d = 0; d < 4; d++) {
-      // out-of-shape check
-      QPoint np = p + QPoint(dx[d], dy[d]);
-      if (blocks.contains(np))
-        continue;
-
-      rotate_t r = rotate_t((rotate + d) % 4);
-      ports[d] = otherPort(realp, r);
-    }
-
-    hints.push_back(PortHint(ports));
-  }
-
-  return hints;
+bool GameState::inMap(int x, int y) const {
+  return 0 <= x && x < mapW && 0 <= y && y < mapH;
 }
 
-void GameState::naiveInitMap(int w, int h) {
-  this->w = w;
-  this->h = h;
-
-  for (auto &col: groundMap_) {
-    for (auto &block: col) {
-      delete block;
-    }
-  }
-  groundMap_.resize(0);
-  groundMap_.resize(w);
-  for (auto &col : groundMap_) {
-    col.resize(h);
-  }
-
-  deviceMap_.resize(0);
-  deviceMap_.resize(w);
-  for (auto &col : deviceMap_) {
-    col.resize(h, nullptr);
-  }
-
-  portMap_.resize(0);
-  portMap_.resize(w);
-  for (auto &col : portMap_) {
-    col.resize(h, std::array<Port *, 4>());
-  }
-
-  QRandomGenerator gen;
-
-  for (int i = 0; i < w; i++) {
-    for (int j = 0; j < h; j++) {
-      qreal rand = rng.generateDouble();
-      groundMap_[i][j] = (rand < itemRatio) ? randomItemFactory() : nullptr;
-    }
-  }
-}
+bool GameState::inMap(QPoint p) const { return inMap(p.x(), p.y()); }
 
 Selector::Selector(QObject *parent)
     : QObject(parent), x(0), y(0), path_({QPoint(0, 0)}) {}
@@ -494,8 +418,16 @@ void Selector::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 }
 
 void GameState::timerEvent(QTimerEvent *e) {
-  if (!pause_ && e->timerId() == timerId)
-    scene->advance();
+  // no snapshots are published while fast forwarding
+  if (e->timerId() == timerId && !fastForward) {
+    // only belts move, the rest of the scene repaints on its own signals
+    for (auto &[serial, state] : simThread->snapshot().belts) {
+      auto it = views.find(serial);
+      if (it != views.end()) {
+        static_cast<Belt *>(it->second)->setState(state);
+      }
+    }
+  }
 }
 
 void GameState::keyPressEvent(QKeyEvent *e) {
@@ -520,6 +452,9 @@ void GameState::keyPressEvent(QKeyEvent *e) {
     case Key_Right:
       moveSelector(R0);
       break;
+    case Key_D:
+      clearSelection();
+      break;
     }
   } else {
     if (e->modifiers() == Qt::ControlModifier) {
@@ -595,6 +530,15 @@ void GameState::keyPressEvent(QKeyEvent *e) {
     case Key_C:
       center->ensureVisible();
       break;
+    case Key_BracketLeft:
+      stepSpeed(-1);
+      break;
+    case Key_BracketRight:
+      stepSpeed(1);
+      break;
+    case Key_F:
+      toggleFastForward();
+      break;
     }
   }
 }
@@ -608,21 +552,45 @@ void GameState::keyReleaseEvent(QKeyEvent *e) {
         selector->clear();
         return;
       }
-      ItemFactory *ground = groundMap(base);
-      QList<PortHint> hints = getPortHint(base, rotate, selector->path());
-      Device *device =
-          deviceFactory->createDevice(selector->path(), hints, ground);
+      QPoint base = this->base;
+      rotate_t rotate = this->rotate;
+      QList<QPoint> path = selector->path();
+      DeviceFactory *factory = deviceFactory;
       selector->clear();
-      if (device == nullptr) {
-        qCritical() << "create device failed.";
-        return;
-      }
-      installDevice(base, rotate, device);
+      simThread->post([this, base, rotate, path, factory](Simulation &sim) {
+        ItemFactory *ground = sim.ground(base);
+        QList<PortHint> hints = sim.getPortHint(base, rotate, path);
+        DeviceModel *device = factory->createDevice(path, hints, ground);
+        if (device == nullptr) {
+          qCritical() << "create device failed.";
+          return;
+        }
+        installDevice(sim, base, rotate, device);
+        flushViews();
+      });
       return;
     }
   }
 }
 
+qint64 GameState::offlineLimit() {
+  return QSettings("CShapeZ", "CShapeZ")
+      .value("offlineLimit", 8 * 3600)
+      .toLongLong();
+}
+
+void GameState::creditOffline() {
+  if (savedAt <= 0) {
+    return;
+  }
+  qint64 elapsed = QDateTime::currentSecsSinceEpoch() - savedAt;
+  elapsed = qBound(qint64(0), elapsed, offlineLimit());
+  // the thread has not started yet, the simulation is still ours; the
+  // factory is taken to have run at its steady-state rates all along
+  Throughput throughput(*simulation);
+  goalManager->receiveRates(throughput.delivered(), elapsed);
+}
+
 void GameState::enhanceChange()
 {
   enhance ++;
@@ -644,37 +612,14 @@ void GameState::shopOpenEvent()
 
 void GameState::mapConstructEvent()
 {
-  pause_ = true;
-  killTimer(timerId);
-  std::vector<Device *> devList;
-  for (auto &[dev, desc]: devices) {
-    devList.push_back(dev);
-  }
-
-  for (auto &dev: devList) {
-    if (dynamic_cast<Center *>(dev)) {
-      continue;
-    }
-    removeDevice(dev);
-  }
-  scene->removeItem(center);
-  devices.erase(center);
-
-  w = nextW; h = nextH;
-  naiveInitMap(w, h);
-
-  QPoint centerBase = {rng.bounded(w - 4), rng.bounded(h - 4)};
-  rotate_t centerRotate = R0;
-  installDevice(centerBase, centerRotate, center);
-  resetDeviceRatio();
-  for (int i = 0; i < DEV_NONE; i ++) {
-    emit deviceRatioChangeEvent(device_id_t(i), getDeviceRatio(device_id_t(i)));
-  }
-  assert(scene->items().size() == 2);
-
-  scene->update(0, 0, w * L, h * L);
-  pause_ = false;
-  timerId = startTimer(1000/FPS);
+  int w = nextW, h = nextH;
+  qreal ratio = itemRatio;
+  simThread->post([this, w, h, ratio](Simulation &sim) {
+    // the factory is kept, the map grows around it
+    sim.grow(qMax(w, sim.width()), qMax(h, sim.height()), ratio);
+    copyMap(sim);
+    gui([this] { scene->update(); });
+  });
 }
 
 bool GameState::eventFilter(QObject *object, QEvent *event) {
@@ -689,14 +634,8 @@ bool GameState::eventFilter(QObject *object, QEvent *event) {
   }
 }
 
-DeviceDescription::DeviceDescription(QPoint point, rotate_t rotate)
-    : p(point), r(rotate) {}
-
-DeviceDescription::DeviceDescription(int x, int y, rotate_t rotate)
-    : p(QPoint(x, y)), r(rotate) {}
-
-Scene::Scene(int w, int h, GameState &game, QObject *parent)
-  : QGraphicsScene(parent), w(w), h(h), game(game) {}
+Scene::Scene(GameState &game, QObject *parent)
+  : QGraphicsScene(parent), game(game) {}
 
 void Scene::drawBackground(QPainter *painter, const QRectF &rect) {
   painter->save();
@@ -714,14 +653,10 @@ void Scene::drawBackground(QPainter *painter, const QRectF &rect) {
   for (int x = sx; x < ex; x += L) {
     for (int y = sy; y < ey; y += L) {
       painter->save();
-      if (game.inRange(x / L, y / L)) {
-        if (auto f = game.groundMap(x / L, y / L)) {
-          QColor color = f->color();
-          if (color == Qt::gray) {
-            color = Qt::darkGray;
-          }
-          painter->setBrush(QColor(f->color()).lighter());
-        }
+      // the ground goes on past the map, paler
+      if (auto f = tileFactory(game.ground.tile(x / L, y / L))) {
+        bool inMap = game.inMap(x / L, y / L);
+        painter->setBrush(QColor(f->color()).lighter(inMap ? 150 : 180));
       }
       painter->drawRect(x, y, L, L);
       painter->restore();
@@ -5,8 +5,12 @@
 #include "item.h"
 #include "goalmanager.h"
 #include "shop.h"
+#include "simthread.h"
+#include "simulation.h"
+#include "throughput.h"
 #include <QtWidgets>
 #include <map>
+#include <unordered_map>
 
 class Selector : public QObject, public QGraphicsItem {
   Q_OBJECT
@@ -27,27 +31,18 @@ private:
   QList<QPoint> path_;
 };
 
-struct DeviceDescription {
-  const QPoint p;
-  const rotate_t r;
-
-  DeviceDescription(QPoint point, rotate_t rotate);
-  DeviceDescription(int x, int y, rotate_t rotate);
-};
-
 class GameState;
 
 class Scene : public QGraphicsScene {
   Q_OBJECT
 public:
-  explicit Scene(int w, int h, GameState &game, QObject *parent = nullptr);
+  explicit Scene(GameState &game, QObject *parent = nullptr);
 
   // QGraphicsScene interface
 protected:
   void drawBackground(QPainter *painter, const QRectF &rect) override;
 
 private:
-  const int w, h;
   GameState &game;
 
   // QGraphicsScene interface
@@ -62,6 +57,7 @@ class GameState : public QWidget {
 public:
   explicit GameState(int w, int h, Scene *&scene, GoalManager *&goal,
                      QMainWindow *parent = nullptr);
+  ~GameState();
   void pause(bool paused);
 
   // serialize
@@ -91,36 +87,48 @@ signals:
   void zoomIn();
   void zoomOut();
   void zoomReset();
+  void speedChangeEvent(int speed); // 0 for as fast as possible
 
 private:
-  // interfaces for self
-  bool installDevice(QPoint base, rotate_t rotate, Device *device);
-  void removeDevice(Device *device);
+  // interfaces for self, they queue edits for the simulation thread
   void removeDevice(int x, int y);
   void removeDevice(QPoint p);
+  void clearSelection(); // the devices in the rectangle the selection spans
   void changeDevice(device_id_t id);
+  void stepSpeed(int step);  // through SPEEDS
+  void toggleFastForward(); // as fast as possible, without painting
+  void leaveFastForward();  // thaws the frozen lines, see setSteadyState()
+  // credits the time since the save was written, see offlineLimit()
+  void creditOffline();
+  // the most offline time credited, in secs; the "offlineLimit" setting
+  static qint64 offlineLimit();
 
 private: // helper functions
-  bool inRange(int x, int y);
-  bool inRange(QPoint p);
-  QPoint mapToMap(QPoint p, QPoint base, rotate_t rotate);
-  ItemFactory *&groundMap(int x, int y);
-  ItemFactory *&groundMap(QPoint p);
-  Device *&deviceMap(int x, int y);
-  Device *&deviceMap(QPoint p);
-  Port *&portMap(int x, int y, rotate_t r);
-  Port *&portMap(QPoint p, rotate_t r);
-  Port *otherPort(QPoint p, rotate_t r);
   void moveSelector(rotate_t d);
   void shiftSelector(rotate_t d);
-  QList<PortHint> getPortHint(QPoint base, rotate_t rotate,
-                              const QList<QPoint> &blocks);
-  void naiveInitMap(int w, int h);
-  void loadMap(QDataStream &in);
+  void initScene(Scene *&scene, QMainWindow *parent);
   bool enhanceDevice(device_id_t id);
+  bool inMap(int x, int y) const;
+  bool inMap(QPoint p) const;
+  // runs f on the GUI thread, at once if called from there
+  void gui(std::function<void()> f);
+
+  // on the simulation thread
+  bool installDevice(Simulation &sim, QPoint base, rotate_t rotate,
+                     DeviceModel *device);
+  void addView(Simulation &sim, DeviceModel *model);
+  void removeView(DeviceModel *model);
+  // shows and hides the views added and removed since the last call, in one
+  // call to the GUI thread however many devices a batch edited
+  void flushViews();
+  void copyMap(Simulation &sim);
+  void capture(Snapshot &snapshot);
+
+  // on the GUI thread
+  void showView(quint64 serial, Device *view);
+  void hideView(quint64 serial);
 
 private: // states
-  int w, h;
   /* GUI elements */
   // window
   QMainWindow *window;
@@ -134,16 +142,29 @@ private: // states
   // selector FSM
   bool selectorState;
 
-  /* mapping */
-  std::vector<std::vector<ItemFactory *>> groundMap_;
-  std::vector<std::vector<Device *>> deviceMap_;
-  std::vector<std::vector<std::array<Port *, 4>>> portMap_;
-
-  std::map<Device *, DeviceDescription> devices;
+  /* simulation */
+  // owned by simThread once it runs, see SimThread
+  Simulation *simulation;
+  SimThread *simThread;
+  // a view's serial is the id of its model, see SlotId::key(); it is never
+  // reused, snapshots and the GUI refer to the view by it
+  std::unordered_map<quint64, BeltModel *> belts; // simulation thread
+  // views to show, nullptr for one to hide; simulation thread
+  std::vector<std::pair<quint64, Device *>> viewEdits;
+  std::map<quint64, Device *> views;                  // GUI thread
+  // GUI copy of the map, it only changes when the map grows; the copy
+  // generates the chunks of ground it paints by itself
+  int mapW, mapH;
+  Ground ground;
 
   /* game control */
   int timerId;
   bool pause_;
+  // frames per displayed frame
+  static constexpr std::array<int, 10> SPEEDS = {
+      1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+  int speed; // SPEEDS index
+  bool fastForward;
   device_id_t deviceId;
   DeviceFactory *deviceFactory;
 
@@ -155,6 +176,7 @@ private: // states
   qreal moneyRatio;
   qreal itemRatio;
   int nextW, nextH;
+  qint64 savedAt; // secs since the epoch, 0 for a new game or an older save
 };
 
 #endif // GAMESTATE_H
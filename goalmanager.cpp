@@ -2,21 +2,17 @@
 
 GoalManager::GoalManager()
     : problemSet(0), task(0), received(0),
-      required(std::get<3>(levels[problemSet][task])), icon(nullptr) {
+      required(std::get<3>(levels[problemSet][task])) {
   auto &[type, shape, trait, num] = levels[problemSet][task];
   ref = getMine(type, shape, R0, trait);
-
-  updateIcon();
 }
 
-GoalManager::GoalManager(QDataStream &in) : icon(nullptr) {
+GoalManager::GoalManager(QDataStream &in) {
   in >> problemSet >> task >> received;
   auto &[type, shape, trait, num] = levels[problemSet][task];
   required = num;
   assert(inRange());
   ref = getMine(type, shape, R0, trait);
-
-  updateIcon();
 }
 
 void GoalManager::save(QDataStream &out) {
@@ -34,6 +30,42 @@ void GoalManager::receiveItem(const Item *item) {
   }
 }
 
+qreal GoalManager::receiveRates(const std::map<const Item *, qreal> &rates,
+                                qreal seconds) {
+  qreal value = 0; // per sec
+  for (auto &[item, rate] : rates) {
+    if (auto mine = dynamic_cast<const Mine *>(item)) {
+      value += rate * mine->value();
+    }
+  }
+
+  // the factory outlives a problem set, the map only grows
+  qreal used = 0;
+  while (used < seconds) {
+    qreal goalRate = 0;
+    for (auto &[item, rate] : rates) {
+      auto mine = dynamic_cast<const Mine *>(item);
+      if (mine && *mine == *ref) {
+        goalRate += rate;
+      }
+    }
+    qreal left = seconds - used;
+    if (goalRate * left < required - received) {
+      // the task is not finished in time
+      received += int(goalRate * left);
+      used = seconds;
+      emit updateGoal(problemSet, task, received, required, ref);
+      break;
+    }
+    used += (required - received) / goalRate;
+    received = required - 1;
+    advance();
+  }
+
+  emit moneyChange(qRound(value * used));
+  return used;
+}
+
 void GoalManager::advance() {
   assert(inRange());
 
@@ -59,14 +91,10 @@ void GoalManager::advance() {
   if (sync) {
     auto &[type, shape, trait, num] = levels[problemSet][task];
     required = num;
-    if (ref) {
-      delete ref;
-    }
     ref = getMine(type, shape, R0, trait);
-    updateIcon();
   }
 
-  emit updateGoal(problemSet, task, received, required, icon);
+  emit updateGoal(problemSet, task, received, required, ref);
 }
 
 bool GoalManager::inRange()
@@ -85,21 +113,9 @@ bool GoalManager::inRange()
   return true;
 }
 
-void GoalManager::updateIcon()
-{
-  if (icon != nullptr) {
-    delete icon;
-  }
-  icon = new QPicture();
-  QPainter painter(icon);
-
-  assert(ref);
-  ref->paint(&painter);
-}
-
 void GoalManager::init()
 {
-  emit updateGoal(problemSet, task, received, required, icon);
+  emit updateGoal(problemSet, task, received, required, ref);
 }
 
 const std::vector<GoalManager::ProblemSet> GoalManager::levels = {
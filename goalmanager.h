@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include "item.h"
+#include <map>
 
 class GoalManager : public QObject {
   Q_OBJECT
@@ -14,11 +15,17 @@ public:
   void save(QDataStream &out);
   void init();
 
+  // Credits what arrives over seconds at the given rates (items per sec, as
+  // computed by Throughput) at once, with the signals receiveItem() would
+  // have sent, the money summed up. Returns the seconds credited.
+  qreal receiveRates(const std::map<const Item *, qreal> &rates,
+                     qreal seconds);
+
 public slots:
   void receiveItem(const Item *item);
 
 signals:
-  void updateGoal(int problemSet, int task, int received, int required, const QPicture *icon);
+  void updateGoal(int problemSet, int task, int received, int required, const Item *goal);
   void enhanceChange();
   void moneyChange(int delta);
   void mapConstructEvent();
@@ -26,14 +33,12 @@ signals:
 private:
   void advance(); // Having received a correct item. What's next?
   bool inRange();
-  void updateIcon();
 
 private:
   int problemSet, task;
   int received, required;
 
   const Mine *ref;
-  QPicture *icon;
 
   using Task = std::tuple<type_t, shape_t, trait_t, int>;
   using ProblemSet = std::vector<Task>;
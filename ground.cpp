@@ -0,0 +1,249 @@
+#include "ground.h"
+#include <algorithm>
+#include <vector>
+
+// floor(a / b) for b > 0, also for negative a
+static int floorDiv(int a, int b) {
+  return a >= 0 ? a / b : -((-a - 1) / b) - 1;
+}
+
+static qreal smooth(qreal t) { return t * t * (3 - 2 * t); }
+
+Ground::Ground(quint32 seed, qreal richness)
+    : seed(seed), richness_(richness), threshold_(threshold(richness)),
+      budget(DEFAULT_BUDGET), clock(0) {}
+
+tile_t Ground::tile(int x, int y) {
+  return chunk(x, y).tiles[(y & (CHUNK_SIZE - 1)) << CHUNK_BITS |
+                           (x & (CHUNK_SIZE - 1))];
+}
+
+tile_t Ground::tile(QPoint p) { return tile(p.x(), p.y()); }
+
+void Ground::setTile(int x, int y, tile_t tile) {
+  assert(tile < NR_TILE);
+  Chunk &c = chunk(x, y);
+  c.tiles[(y & (CHUNK_SIZE - 1)) << CHUNK_BITS | (x & (CHUNK_SIZE - 1))] =
+      tile;
+  c.edited = true;
+}
+
+qreal Ground::richness() const { return richness_; }
+
+void Ground::setRichness(qreal richness) {
+  richness_ = richness;
+  threshold_ = threshold(richness);
+  for (auto it = chunks.begin(); it != chunks.end();) {
+    it = it->second.edited ? std::next(it) : chunks.erase(it);
+  }
+}
+
+void Ground::setBudget(int chunks) {
+  assert(chunks >= 1);
+  budget = chunks;
+  if (int(this->chunks.size()) > budget) {
+    evict();
+  }
+}
+
+int Ground::chunkCount() const { return chunks.size(); }
+
+int Ground::pagedCount() const { return paged.size(); }
+
+Ground::Ground(QDataStream &in) : budget(DEFAULT_BUDGET), clock(0) {
+  int nr_chunk;
+  in >> seed >> richness_ >> nr_chunk;
+  threshold_ = threshold(richness_);
+  // sanity check
+  assert(nr_chunk >= 0);
+  for (int i = 0; i < nr_chunk; i++) {
+    int cx, cy;
+    in >> cx >> cy;
+    Chunk &c = chunks[chunkKey(cx, cy)];
+    in.readRawData(reinterpret_cast<char *>(c.tiles.data()), c.tiles.size());
+    for (auto tile : c.tiles) {
+      assert(tile < NR_TILE);
+    }
+    c.edited = true;
+    c.used = 0;
+  }
+  if (int(chunks.size()) > budget) {
+    evict();
+  }
+}
+
+void Ground::save(QDataStream &out) const {
+  int nr_chunk = paged.size();
+  for (auto &[key, c] : chunks) {
+    nr_chunk += c.edited;
+  }
+  out << seed << richness_ << nr_chunk;
+  auto write = [&out](quint64 key, const Chunk &c) {
+    out << int(key >> 32) << int(quint32(key));
+    out.writeRawData(reinterpret_cast<const char *>(c.tiles.data()),
+                     c.tiles.size());
+  };
+  for (auto &[key, c] : chunks) {
+    if (c.edited) {
+      write(key, c);
+    }
+  }
+  for (auto &[key, offset] : paged) {
+    Chunk c;
+    readPage(offset, c);
+    write(key, c);
+  }
+}
+
+Ground::Chunk &Ground::chunk(int x, int y) {
+  int cx = x >> CHUNK_BITS, cy = y >> CHUNK_BITS;
+  quint64 key = chunkKey(cx, cy);
+  auto [it, added] = chunks.try_emplace(key);
+  Chunk &c = it->second;
+  // the newest chunk is never evicted
+  c.used = ++clock;
+  if (added) {
+    auto p = paged.find(key);
+    if (p != paged.end()) {
+      readPage(p->second, c);
+      paged.erase(p);
+    } else {
+      for (int j = 0; j < CHUNK_SIZE; j++) {
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+          c.tiles[j << CHUNK_BITS | i] =
+              generate(cx * CHUNK_SIZE + i, cy * CHUNK_SIZE + j);
+        }
+      }
+      c.edited = false;
+    }
+    if (int(chunks.size()) > budget) {
+      evict();
+    }
+  }
+  return c;
+}
+
+void Ground::evict() {
+  // a quarter of the budget is freed at once, so the scan is amortized over
+  // as many new chunks
+  std::vector<quint64> uses;
+  uses.reserve(chunks.size());
+  for (auto &[key, c] : chunks) {
+    uses.push_back(c.used);
+  }
+  int keep = qMax(1, budget - budget / 4);
+  auto first = uses.end() - keep;
+  std::nth_element(uses.begin(), first, uses.end());
+  quint64 oldest = *first; // of the chunks kept
+  for (auto it = chunks.begin(); it != chunks.end();) {
+    Chunk &c = it->second;
+    if (c.used < oldest && (!c.edited || pageOut(it->first, c))) {
+      it = chunks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool Ground::pageOut(quint64 key, const Chunk &c) {
+  if (!pageFile) {
+    pageFile = std::make_shared<PageFile>();
+    if (!pageFile->file.open()) {
+      qCritical() << "cannot open a page file for the ground, edited chunks"
+                  << "stay in memory";
+      pageFile.reset();
+      return false;
+    }
+  }
+  QMutexLocker locker(&pageFile->lock);
+  QFile &file = pageFile->file;
+  qint64 offset = file.size();
+  file.seek(offset);
+  if (file.write(reinterpret_cast<const char *>(c.tiles.data()),
+                 c.tiles.size()) != qint64(c.tiles.size())) {
+    qCritical() << "cannot write to the page file of the ground";
+    return false;
+  }
+  paged[key] = offset;
+  return true;
+}
+
+void Ground::readPage(qint64 offset, Chunk &c) const {
+  QMutexLocker locker(&pageFile->lock);
+  QFile &file = pageFile->file;
+  file.seek(offset);
+  qint64 read =
+      file.read(reinterpret_cast<char *>(c.tiles.data()), c.tiles.size());
+  assert(read == qint64(c.tiles.size()));
+  c.edited = true;
+}
+
+quint64 Ground::chunkKey(int cx, int cy) {
+  return quint64(quint32(cx)) << 32 | quint32(cy);
+}
+
+tile_t Ground::generate(int x, int y) const {
+  // a higher richness raises the threshold, which grows the same patches
+  if (density(x, y) >= threshold_) {
+    return NO_TILE;
+  }
+  // the kinds and their odds are those of the old random maps
+  int cx = floorDiv(x + 4, 8), cy = floorDiv(y + 4, 8);
+  if (hash(cx, cy, 3) < 0.3) {
+    return hash(cx, cy, 4) < 0.5 ? RED_TILE : BLUE_TILE;
+  } else {
+    return hash(cx, cy, 4) < 0.5 ? ROUND_TILE : SQUARE_TILE;
+  }
+}
+
+qreal Ground::density(int x, int y) const {
+  return 0.75 * noise(x, y, 8, 1) + 0.25 * noise(x, y, 3, 2);
+}
+
+qreal Ground::threshold(qreal richness) {
+  if (richness <= 0) {
+    return 0;
+  } else if (richness >= 1) {
+    return 1;
+  }
+  // the noise is far from uniform, most of it is close to 0.5; the share of
+  // tiles below a threshold is taken from a sorted sample of it, which does
+  // not depend on the seed
+  static const std::vector<qreal> sample = [] {
+    const int SIZE = 256;
+    Ground ground(0, 0); // richness 0 does not need the sample
+    std::vector<qreal> sample;
+    sample.reserve(SIZE * SIZE);
+    for (int x = 0; x < SIZE; x++) {
+      for (int y = 0; y < SIZE; y++) {
+        sample.push_back(ground.density(x, y));
+      }
+    }
+    std::sort(sample.begin(), sample.end());
+    return sample;
+  }();
+  return sample[int(richness * sample.size())];
+}
+
+qreal Ground::noise(int x, int y, int scale, quint32 salt) const {
+  // value noise: random values on a lattice, interpolated smoothly
+  int ix = floorDiv(x, scale), iy = floorDiv(y, scale);
+  qreal fx = smooth((x - ix * scale + 0.5) / scale);
+  qreal fy = smooth((y - iy * scale + 0.5) / scale);
+  qreal top = hash(ix, iy, salt) * (1 - fx) + hash(ix + 1, iy, salt) * fx;
+  qreal bottom =
+      hash(ix, iy + 1, salt) * (1 - fx) + hash(ix + 1, iy + 1, salt) * fx;
+  return top * (1 - fy) + bottom * fy;
+}
+
+qreal Ground::hash(int x, int y, quint32 salt) const {
+  // the finalizer of MurmurHash3 over the coordinates, seed and salt
+  quint64 h = quint64(quint32(x)) << 32 | quint32(y);
+  h ^= (quint64(seed) << 32 | salt) * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return (h >> 11) * (1.0 / (1ULL << 53));
+}
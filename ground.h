@@ -0,0 +1,77 @@
+#ifndef GROUND_H
+#define GROUND_H
+
+#include "item.h"
+#include <QtCore>
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+// The ground of an unbounded world. A tile is a function of the seed and the
+// richness: coherent noise decides where resources lie, so they come in
+// patches, and a coarser grid of cells decides what a patch holds. Chunks of
+// tiles are generated the first time one of their tiles is read, so it costs
+// the same to start a small or a large world.
+// Tiles can also be set, like the whole map of a save written before the
+// ground was generated; their chunks are edited, and only those are saved.
+// At most a budget of chunks stays in memory. Past it, the ones read least
+// recently are dropped: generated chunks are generated again when needed,
+// and edited ones are paged out to a temporary file shared by the copies of
+// the Ground.
+class Ground {
+public:
+  static constexpr int CHUNK_BITS = 5;
+  static constexpr int CHUNK_SIZE = 1 << CHUNK_BITS;
+  static constexpr int DEFAULT_BUDGET = 1024; // chunks, of about 1 KB
+
+  explicit Ground(quint32 seed = 0, qreal richness = 0);
+
+  tile_t tile(int x, int y);
+  tile_t tile(QPoint p);
+  void setTile(int x, int y, tile_t tile);
+  qreal richness() const;
+  // the share of tiles with resources; raising it only adds resources, so
+  // no miner loses its tile, see generate()
+  void setRichness(qreal richness);
+  void setBudget(int chunks);
+  int chunkCount() const; // in memory
+  int pagedCount() const; // edited chunks in the page file
+
+  // serialize
+  explicit Ground(QDataStream &in);
+  void save(QDataStream &out) const;
+
+private:
+  struct Chunk {
+    std::array<tile_t, CHUNK_SIZE * CHUNK_SIZE> tiles;
+    bool edited;
+    quint64 used; // clock of the last read
+  };
+  // records are only appended, so every copy can read what it wrote
+  struct PageFile {
+    QMutex lock;
+    QTemporaryFile file;
+  };
+
+  Chunk &chunk(int x, int y); // paged in or generated if missing
+  void evict(); // down to 3/4 of the budget
+  bool pageOut(quint64 key, const Chunk &c);
+  void readPage(qint64 offset, Chunk &c) const;
+  static quint64 chunkKey(int cx, int cy);
+  tile_t generate(int x, int y) const;
+  qreal density(int x, int y) const; // below threshold() for resources
+  static qreal threshold(qreal richness);
+  qreal noise(int x, int y, int scale, quint32 salt) const; // in [0, 1)
+  qreal hash(int x, int y, quint32 salt) const;            // in [0, 1)
+
+  quint32 seed;
+  qreal richness_;
+  qreal threshold_; // threshold(richness_)
+  std::unordered_map<quint64, Chunk> chunks; // by chunkKey()
+  int budget;
+  quint64 clock;
+  std::shared_ptr<PageFile> pageFile; // opened with the first page out
+  std::unordered_map<quint64, qint64> paged; // offsets in pageFile
+};
+
+#endif // GROUND_H
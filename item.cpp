@@ -6,248 +6,331 @@
 //  return x;
 //}
 
-Item::Item() {}
-
-Item::~Item()
-{
-
+/* Mine codes and transition tables
+ *
+ * A Mine is packed into a code, its index in the interned table:
+ *   ((type * NR_SHAPE + shape index) * NR_ROTATE + rotate) * NR_TRAIT
+ *     + trait index
+ * Every transform is a lookup in a table built at compile time from the
+ * quadrants a Mine covers; NO_MINE stands for "nothing left". The tables
+ * are checked against the switch logic they replaced at the end of this
+ * section.
+ */
+
+static constexpr int NR_TYPE = 2, NR_SHAPE = 3, NR_ROTATE = 4, NR_TRAIT = 3;
+static constexpr int NR_MINE = NR_TYPE * NR_SHAPE * NR_ROTATE * NR_TRAIT;
+static constexpr quint8 NO_MINE = 0xff;
+
+static constexpr shape_t SHAPES[NR_SHAPE] = {QUARTER, HALF, FULL};
+static constexpr trait_t TRAITS[NR_TRAIT] = {BLACK, RED, BLUE};
+
+static constexpr int traitIndex(trait_t trait) {
+  return trait == BLACK ? 0 : trait == RED ? 1 : 2;
 }
 
-void Item::paint(QPainter *painter) const {
-  qWarning() << "default item image is painted.";
-  painter->save();
-  painter->setPen(Qt::red);
-  painter->drawRect(QRectF(-R, -R, 2*R, 2*R));
-  painter->drawLine(-R, -R, R, R);
-  painter->drawLine(R, -R, -R, R);
-  painter->restore();
+static constexpr int shapeIndex(shape_t shape) {
+  return shape == QUARTER ? 0 : shape == HALF ? 1 : 2;
 }
 
-TraitMine::TraitMine(trait_t trait) : trait(trait) {}
-
-trait_t TraitMine::getTrait() const { return trait; }
-
-Mine::Mine(type_t type, shape_t shape, rotate_t rotate, trait_t trait)
-    : type(type), shape(shape), rotate(rotate), trait(trait) {
+static constexpr int mineCode(type_t type, shape_t shape, rotate_t rotate,
+                              trait_t trait) {
+  return ((type * NR_SHAPE + shapeIndex(shape)) * NR_ROTATE + rotate) *
+             NR_TRAIT +
+         traitIndex(trait);
+}
 
+static constexpr type_t codeType(int code) {
+  return type_t(code / (NR_TRAIT * NR_ROTATE * NR_SHAPE));
+}
+static constexpr shape_t codeShape(int code) {
+  return SHAPES[code / (NR_TRAIT * NR_ROTATE) % NR_SHAPE];
+}
+static constexpr rotate_t codeRotate(int code) {
+  return rotate_t(code / NR_TRAIT % NR_ROTATE);
 }
+static constexpr trait_t codeTrait(int code) { return TRAITS[code % NR_TRAIT]; }
 
-Mine::Mine(const Mine &o)
-    : type(o.type), shape(o.shape), rotate(o.rotate), trait(o.trait) {}
+// quadrants, clockwise: upper left, upper right, lower right, lower left
+static constexpr int UPPER = 0b0011, LOWER = 0b1100;
 
-bool Mine::operator==(const Mine &o) const {
-  return type == o.type && shape == o.shape && trait == o.trait;
-}
+// the quadrant of a QUARTER, rotateR() turns it clockwise
+static constexpr int quadrant(int rotate) { return (5 - rotate) % 4; }
 
-int Mine::value() const
-{
-  int sum = 0;
+static constexpr int quadrants(shape_t shape, rotate_t rotate) {
   switch (shape) {
-  case FULL:
-    sum = 4;
-    break;
-  case HALF:
-    sum = 2;
-    break;
   case QUARTER:
-    sum = 1;
-    break;
-  default:
-    assert(false);
+    return 1 << quadrant(rotate);
+  case HALF:
+    return 1 << quadrant(rotate) | 1 << quadrant((rotate + 1) % 4);
+  case FULL:
+    return 0b1111;
   }
+  return 0;
+}
 
-  switch (trait) {
-  case BLACK:
-    break;
-  default:
-    sum *= 2;
+// the part of code inside keep, the same Mine if nothing is cut away
+static constexpr quint8 cut(int code, int keep) {
+  int q = quadrants(codeShape(code), codeRotate(code));
+  if ((q & keep) == q) {
+    return code;
   }
-  return sum;
+  for (auto s : SHAPES) {
+    for (int r = 0; r < NR_ROTATE; r++) {
+      if (quadrants(s, rotate_t(r)) == (q & keep)) {
+        return mineCode(codeType(code), s, rotate_t(r), codeTrait(code));
+      }
+    }
+  }
+  return NO_MINE;
 }
 
-const Mine *Mine::setTrait(trait_t trait) const {
-  return new Mine(type, shape, rotate, trait);
+struct MineTables {
+  std::array<quint8, NR_MINE> cutUpper, cutLower, rotateR;
+  std::array<std::array<quint8, NR_MINE>, NR_TRAIT> setTrait;
+  std::array<quint8, NR_MINE> value;
+  std::array<quint8, NR_MINE> goalKey; // equal for Mines a goal accepts
+};
+
+static constexpr MineTables makeTables() {
+  MineTables t = {};
+  for (int c = 0; c < NR_MINE; c++) {
+    type_t type = codeType(c);
+    shape_t shape = codeShape(c);
+    rotate_t rotate = codeRotate(c);
+    trait_t trait = codeTrait(c);
+    t.cutUpper[c] = cut(c, UPPER);
+    t.cutLower[c] = cut(c, LOWER);
+    t.rotateR[c] = mineCode(type, shape, rotate_t((rotate + 3) % 4), trait);
+    for (int i = 0; i < NR_TRAIT; i++) {
+      t.setTrait[i][c] = mineCode(type, shape, rotate, TRAITS[i]);
+    }
+    int q = quadrants(shape, rotate);
+    int area = (q & 1) + (q >> 1 & 1) + (q >> 2 & 1) + (q >> 3 & 1);
+    t.value[c] = trait == BLACK ? area : area * 2;
+    // rotation does not matter for goals
+    t.goalKey[c] = (type * NR_SHAPE + shapeIndex(shape)) * NR_TRAIT +
+                   traitIndex(trait);
+  }
+  return t;
 }
 
-const Mine *Mine::rotateR() const {
-  return new Mine(type, shape, rotate_t((rotate + 3) % 4), trait);
-}
+static constexpr MineTables tables = makeTables();
 
-const Mine *Mine::cutUpper() const {
-  switch (shape) {
+// the switch logic the tables replaced
+static constexpr int switchCutUpper(int c) {
+  type_t type = codeType(c);
+  trait_t trait = codeTrait(c);
+  switch (codeShape(c)) {
   case FULL:
-    return new Mine(type, HALF, R0, trait);
+    return mineCode(type, HALF, R0, trait);
   case HALF:
-    switch (rotate) {
+    switch (codeRotate(c)) {
     case R0:
-      return new Mine(*this);
+      return c;
     case R90:
-      return new Mine(type, QUARTER, R90, trait);
+      return mineCode(type, QUARTER, R90, trait);
     case R180:
-      return nullptr;
+      return NO_MINE;
     case R270:
-      return new Mine(type, QUARTER, R0, trait);
+      return mineCode(type, QUARTER, R0, trait);
     }
+    break;
   case QUARTER:
-    switch (rotate) {
+    switch (codeRotate(c)) {
     case R0:
     case R90:
-      return new Mine(*this);
+      return c;
     default:
-      return nullptr;
+      return NO_MINE;
     }
   }
+  return -1;
 }
 
-const Mine *Mine::cutLower() const {
-  switch (shape) {
+static constexpr int switchCutLower(int c) {
+  type_t type = codeType(c);
+  trait_t trait = codeTrait(c);
+  switch (codeShape(c)) {
   case FULL:
-    return new Mine(type, HALF, R180, trait);
+    return mineCode(type, HALF, R180, trait);
   case HALF:
-    switch (rotate) {
+    switch (codeRotate(c)) {
     case R0:
-      return nullptr;
+      return NO_MINE;
     case R90:
-      return new Mine(type, QUARTER, R180, trait);
+      return mineCode(type, QUARTER, R180, trait);
     case R180:
-      return new Mine(*this);
+      return c;
     case R270:
-      return new Mine(type, QUARTER, R270, trait);
+      return mineCode(type, QUARTER, R270, trait);
     }
+    break;
   case QUARTER:
-    switch (rotate) {
+    switch (codeRotate(c)) {
     case R0:
     case R90:
-      return nullptr;
+      return NO_MINE;
     default:
-      return new Mine(*this);
+      return c;
     }
   }
+  return -1;
 }
 
-void Mine::paint(QPainter *painter) const {
-  painter->save();
-  painter->setPen(QPen(Qt::darkGray, L/16));
-  painter->setBrush(QBrush(Qt::GlobalColor(trait)));
-  QRectF bound(-R, -R, 2*R, 2*R);
-  painter->rotate(-rotate * 90);
-  switch (type) {
-  case ROUND:
-//    painter->drawPie(bound, rotate * 90 * 16, shape * 90 * 16);
-    switch (shape) {
-    case FULL:
-      painter->drawPie(bound, 180*16, 90*16);
-      painter->drawPie(bound, 270*16, 90*16);
-    case HALF: // fall through
-      painter->drawPie(bound, 90*16, 90*16);
-    case QUARTER: // fall through
-      painter->drawPie(bound, 0, 90*16);
-    }
-
+static constexpr int switchValue(int c) {
+  int sum = 0;
+  switch (codeShape(c)) {
+  case FULL:
+    sum = 4;
     break;
-  case SQUARE:
-    switch (shape) {
-    case FULL:
-      painter->drawRect(QRectF(-R, 0, R, R));
-      painter->drawRect(QRectF(0, 0, R, R));
-    case HALF: // fall through
-      painter->drawRect(QRectF(-R, -R, R, R));
-    case QUARTER: // fall through
-      painter->drawRect(QRectF(0, -R, R, R));
-    }
+  case HALF:
+    sum = 2;
+    break;
+  case QUARTER:
+    sum = 1;
     break;
   }
-  painter->restore();
+  switch (codeTrait(c)) {
+  case BLACK:
+    break;
+  default:
+    sum *= 2;
+  }
+  return sum;
 }
 
-void ItemFactory::save(QDataStream &out)
-{
+static constexpr bool tablesMatchSwitches() {
+  for (int a = 0; a < NR_MINE; a++) {
+    if (tables.cutUpper[a] != switchCutUpper(a) ||
+        tables.cutLower[a] != switchCutLower(a) ||
+        tables.value[a] != switchValue(a)) {
+      return false;
+    }
+    int r = tables.rotateR[a];
+    if (codeRotate(r) != (codeRotate(a) + 3) % 4 ||
+        codeType(r) != codeType(a) || codeShape(r) != codeShape(a) ||
+        codeTrait(r) != codeTrait(a)) {
+      return false;
+    }
+    for (int i = 0; i < NR_TRAIT; i++) {
+      int s = tables.setTrait[i][a];
+      if (codeTrait(s) != TRAITS[i] || codeType(s) != codeType(a) ||
+          codeShape(s) != codeShape(a) || codeRotate(s) != codeRotate(a)) {
+        return false;
+      }
+    }
+    for (int b = 0; b < NR_MINE; b++) {
+      bool same = codeType(a) == codeType(b) &&
+                  codeShape(a) == codeShape(b) &&
+                  codeTrait(a) == codeTrait(b);
+      if ((tables.goalKey[a] == tables.goalKey[b]) != same) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
-ItemFactory::ItemFactory()
+static_assert(tablesMatchSwitches(),
+              "Mine transition tables disagree with the reference logic");
+
+Item::Item() {}
+
+Item::~Item()
 {
 
 }
 
-ItemFactory::~ItemFactory() {}
+TraitMine::TraitMine(trait_t trait) : trait(trait) {}
 
-ItemFactory::ItemFactory(QDataStream &in)
-{
+trait_t TraitMine::getTrait() const { return trait; }
 
+Mine::Mine(type_t type, shape_t shape, rotate_t rotate, trait_t trait)
+    : type(type), shape(shape), rotate(rotate), trait(trait),
+      code(mineCode(type, shape, rotate, trait)) {}
+
+bool Mine::operator==(const Mine &o) const {
+  return tables.goalKey[code] == tables.goalKey[o.code];
 }
 
-MineFactory::MineFactory(type_t type, trait_t trait)
-  : type(type), trait(trait) {}
+int Mine::value() const { return tables.value[code]; }
 
-MineFactory::MineFactory(QDataStream &in)
-  : ItemFactory(in)
-{
-  in >> type >> trait;
+const Mine *Mine::setTrait(trait_t trait) const {
+  return byCode(tables.setTrait[traitIndex(trait)][code]);
 }
 
-void MineFactory::save(QDataStream &out)
-{
-  ItemFactory::save(out);
-  out << type << trait;
-}
+const Mine *Mine::rotateR() const { return byCode(tables.rotateR[code]); }
 
-Mine *MineFactory::createItem() const {
-  return new Mine(type, FULL, R0, trait);
-}
+const Mine *Mine::cutUpper() const { return byCode(tables.cutUpper[code]); }
 
-TraitFactory::TraitFactory(trait_t trait) : trait(trait) {}
+const Mine *Mine::cutLower() const { return byCode(tables.cutLower[code]); }
+
+type_t Mine::getType() const { return type; }
+
+shape_t Mine::getShape() const { return shape; }
 
-TraitFactory::TraitFactory(QDataStream &in)
-  : ItemFactory(in)
+rotate_t Mine::getRotate() const { return rotate; }
+
+trait_t Mine::getTrait() const { return trait; }
+
+ItemFactory::ItemFactory()
 {
-  in >> trait;
+
 }
 
-void TraitFactory::save(QDataStream &out)
-{
-  out << trait;
+ItemFactory::~ItemFactory() {}
+
+MineFactory::MineFactory(type_t type, trait_t trait)
+  : type(type), trait(trait) {}
+
+const Mine *MineFactory::createItem() const {
+  return getMine(type, FULL, R0, trait);
 }
 
-QColor TraitFactory::color()
+TraitFactory::TraitFactory(trait_t trait) : trait(trait) {}
+
+Qt::GlobalColor TraitFactory::color()
 {
   return Qt::GlobalColor(trait);
 }
 
-TraitMine *TraitFactory::createItem() const { return new TraitMine(trait); }
+const TraitMine *TraitFactory::createItem() const {
+  return getTraitMine(trait);
+}
 
-QDataStream &operator<<(QDataStream &out, Mine *&mine) {
+QDataStream &operator<<(QDataStream &out, const Mine *&mine) {
   assert(mine);
   out << mine->type << mine->shape << mine->rotate << mine->trait;
   return out;
 }
 
-QDataStream &operator>>(QDataStream &in, Mine *&mine) {
+QDataStream &operator>>(QDataStream &in, const Mine *&mine) {
   type_t type;
   shape_t shape;
   rotate_t rotate;
   trait_t trait;
   in >> type >> shape >> rotate >> trait;
-  mine = new Mine(type, shape, rotate, trait);
+  mine = getMine(type, shape, rotate, trait);
   return in;
 }
 
-QDataStream &operator<<(QDataStream &out, TraitMine *&tmine) {
+QDataStream &operator<<(QDataStream &out, const TraitMine *&tmine) {
   assert(tmine);
   out << tmine->trait;
   return out;
 }
 
-QDataStream &operator>>(QDataStream &in, TraitMine *&tmine) {
+QDataStream &operator>>(QDataStream &in, const TraitMine *&tmine) {
   trait_t trait;
   in >> trait;
-  tmine = new TraitMine(trait);
+  tmine = getTraitMine(trait);
   return in;
 }
 
-QDataStream &operator<<(QDataStream &out, Item *&item) {
-  if (Mine *mine = dynamic_cast<Mine *>(item)) {
+QDataStream &operator<<(QDataStream &out, const Item *&item) {
+  if (const Mine *mine = dynamic_cast<const Mine *>(item)) {
     out << QChar('M') << mine;
-  } else if (TraitMine *tmine = dynamic_cast<TraitMine *>(item)) {
+  } else if (const TraitMine *tmine = dynamic_cast<const TraitMine *>(item)) {
     out << QChar('T') << tmine;
   } else {
     assert(false);
@@ -255,15 +338,15 @@ QDataStream &operator<<(QDataStream &out, Item *&item) {
   return out;
 }
 
-QDataStream &operator>>(QDataStream &in, Item *&item) {
+QDataStream &operator>>(QDataStream &in, const Item *&item) {
   QChar c;
   in >> c;
   if (c == 'M') {
-    Mine *mine;
+    const Mine *mine;
     in >> mine;
     item = mine;
   } else if (c == 'T') {
-    TraitMine *tmine;
+    const TraitMine *tmine;
     in >> tmine;
     item = tmine;
   } else {
@@ -272,90 +355,60 @@ QDataStream &operator>>(QDataStream &in, Item *&item) {
   return in;
 }
 
-ItemFactory *randomItemFactory()
+ItemFactory *tileFactory(quint8 tile)
 {
-  if (rng.generate() % 1000 < 300) { // TraitFactory
-    qDebug() << "CREATE TRAITFACTORY";
-    trait_t trait = (rng.generate() & 1) ? RED : BLUE;
-    return new TraitFactory(trait);
-  } else {
-    qDebug() << "CREATE MINEFACTORY";
-    trait_t trait;
-    type_t type;
-    trait = BLACK;
-    type = type_t(rng.generate() % 2);
-    return new MineFactory(type, trait);
-  }
+  static const std::array<ItemFactory *, NR_TILE> table = {
+      nullptr, new MineFactory(ROUND, BLACK), new MineFactory(SQUARE, BLACK),
+      new TraitFactory(RED), new TraitFactory(BLUE)};
+  assert(tile < NR_TILE);
+  return table[tile];
 }
 
 // serialize
-void saveItemFactory(QDataStream &out, ItemFactory *f) {
-  if (f == nullptr) {
-    out << QChar('N');
-    return;
-  }
-  if (auto mf = dynamic_cast<MineFactory *>(f)) {
-    out << QChar('M');
-    mf->save(out);
-  } else if (auto tf = dynamic_cast<TraitFactory *>(f)) {
-    out << QChar('T');
-    tf->save(out);
-  } else {
-    assert(false);
-  }
-}
-
-ItemFactory *loadItemFactory(QDataStream &in) {
-  QChar c;
-  in >> c;
-
-  if (c == 'N') {
-    return nullptr;
-  } else if (c == 'M') {
-    return new MineFactory(in);
-  } else if (c == 'T') {
-    return new TraitFactory(in);
+tile_t loadTaggedTile(QDataStream &in, QChar tag) {
+  if (tag == 'N') {
+    return NO_TILE;
+  } else if (tag == 'M') {
+    // mine factories were always black
+    type_t type;
+    trait_t trait;
+    in >> type >> trait;
+    return type == ROUND ? ROUND_TILE : SQUARE_TILE;
+  } else if (tag == 'T') {
+    trait_t trait;
+    in >> trait;
+    return trait == RED ? RED_TILE : BLUE_TILE;
   } else {
     assert(false);
+    return NO_TILE;
   }
 }
 
-
-QColor MineFactory::color()
+Qt::GlobalColor MineFactory::color()
 {
   return Qt::GlobalColor(trait);
 }
 
+const Mine *Mine::byCode(int code) {
+  // built once, the Mines live until the program exits
+  static const std::array<const Mine *, NR_MINE> table = [] {
+    std::array<const Mine *, NR_MINE> t;
+    for (int c = 0; c < NR_MINE; c++) {
+      t[c] = new Mine(codeType(c), codeShape(c), codeRotate(c), codeTrait(c));
+    }
+    return t;
+  }();
+  return code == NO_MINE ? nullptr : table[code];
+}
 
-
-void TraitMine::paint(QPainter *painter) const
+const Mine *getMine(type_t type, shape_t shape, rotate_t rotate, trait_t trait)
 {
-  painter->save();
-  QString file = ":/item/";
-  switch (trait) {
-  case BLACK:
-    file += "BLACK";
-    break;
-  case BLUE:
-    file += "BLUE";
-    break;
-  case RED:
-    file += "RED";
-    break;
-  }
-
-//  qDebug() << file << trait;
-
-  QImage image(file);
-  if (image.isNull()) {
-    Item::paint(painter);
-  } else {
-    painter->drawImage(QRectF(-R, -R, 2*R, 2*R), image);
-  }
-  painter->restore();
+  return Mine::byCode(mineCode(type, shape, rotate, trait));
 }
 
-const Mine *getMine(type_t type, shape_t shape, rotate_t rotate, trait_t trait)
+const TraitMine *getTraitMine(trait_t trait)
 {
-  return new Mine(type, shape, rotate, trait);
+  static const std::array<const TraitMine *, NR_TRAIT> table = {
+      new TraitMine(BLACK), new TraitMine(RED), new TraitMine(BLUE)};
+  return table[traitIndex(trait)];
 }
@@ -3,46 +3,48 @@
 
 #include "config.h"
 #include "util.h"
-#include <QtWidgets>
+#include <QtCore>
 
 enum trait_t { BLACK = Qt::gray, RED = Qt::darkRed, BLUE = Qt::darkBlue };
 enum type_t { ROUND, SQUARE };
 enum shape_t { QUARTER = 1, HALF = 2, FULL = 4 };
 
+// Items are immutable and interned: every distinct value exists once, in a
+// static table, for the whole run. Devices pass const pointers around and
+// never delete them; compare values with ==, or pointers if rotation matters.
 class Item
 {
 public:
+  virtual ~Item();
+
+protected:
   Item();
-  ~Item();
 
-  virtual void paint(QPainter *painter) const;
+public:
 
   // serialize
-  friend QDataStream &operator<<(QDataStream &out, Item *&item);
-  friend QDataStream &operator>>(QDataStream &in, Item *&item);
+  friend QDataStream &operator<<(QDataStream &out, const Item *&item);
+  friend QDataStream &operator>>(QDataStream &in, const Item *&item);
 };
 
 class TraitMine: public Item {
 public:
-  TraitMine(trait_t trait);
   trait_t getTrait() const;
 
   // serialize
-  friend QDataStream &operator<<(QDataStream &out, TraitMine *&tmine);
-  friend QDataStream &operator>>(QDataStream &in, TraitMine *&tmine);
+  friend QDataStream &operator<<(QDataStream &out, const TraitMine *&tmine);
+  friend QDataStream &operator>>(QDataStream &in, const TraitMine *&tmine);
 
 private:
-  const trait_t trait;
+  explicit TraitMine(trait_t trait);
+  TraitMine(const TraitMine &) = delete;
+  friend const TraitMine *getTraitMine(trait_t trait);
 
-  // Item interface
-public:
-  void paint(QPainter *painter) const override;
+  const trait_t trait;
 };
 
 class Mine: public Item {
 public:
-  explicit Mine(type_t type, shape_t shape, rotate_t rotate, trait_t trait);
-  explicit Mine(const Mine& o);
   bool operator==(const Mine& o) const;
   int value() const;
 
@@ -51,70 +53,88 @@ public:
   const Mine *cutUpper() const;
   const Mine *cutLower() const;
 
-  // Item interface
-  void paint(QPainter *painter) const;
+  type_t getType() const;
+  shape_t getShape() const;
+  rotate_t getRotate() const;
+  trait_t getTrait() const;
 
   // serialize
-  friend QDataStream &operator<<(QDataStream &out, Mine *&mine);
-  friend QDataStream &operator>>(QDataStream &in, Mine *&mine);
+  friend QDataStream &operator<<(QDataStream &out, const Mine *&mine);
+  friend QDataStream &operator>>(QDataStream &in, const Mine *&mine);
 
 private:
+  explicit Mine(type_t type, shape_t shape, rotate_t rotate, trait_t trait);
+  Mine(const Mine &) = delete;
+  friend const Mine *getMine(type_t type, shape_t shape, rotate_t rotate,
+                             trait_t trait);
+  static const Mine *byCode(int code); // nullptr for no Mine
+
   const type_t type;
   const shape_t shape;
   const rotate_t rotate;
   const trait_t trait;
+  const quint8 code; // index in the interned table, see item.cpp
 };
 
+// What a miner extracts from a ground tile. There is one factory per kind of
+// tile, shared by every tile and miner of that kind for the whole run, see
+// tileFactory().
 class ItemFactory {
 public:
-  ItemFactory();
   virtual ~ItemFactory();
-  virtual Item *createItem() const = 0;
-  virtual QColor color() = 0;
+  virtual const Item *createItem() const = 0;
+  virtual Qt::GlobalColor color() = 0;
 
-  // serialize
-  explicit ItemFactory(QDataStream &in);
-  virtual void save(QDataStream &out);
+protected:
+  ItemFactory();
 };
 
 class MineFactory: public ItemFactory {
 public:
-  explicit MineFactory(type_t type, trait_t trait);
-
-  // serialize
-  explicit MineFactory(QDataStream &in);
-  virtual void save(QDataStream &out) override;
-  QColor color() override;
+  Qt::GlobalColor color() override;
 
   // ItemFactory interface
 public:
-  Mine *createItem() const override;
+  const Mine *createItem() const override;
 private:
+  explicit MineFactory(type_t type, trait_t trait);
+  friend ItemFactory *tileFactory(quint8 tile);
+
   type_t type;
   trait_t trait;
 };
 
 class TraitFactory: public ItemFactory {
 public:
-  explicit TraitFactory(trait_t trait);
-
-  // serialize
-  explicit TraitFactory(QDataStream &in);
-  virtual void save(QDataStream &out) override;
-  QColor color() override;
+  Qt::GlobalColor color() override;
 
 public:
-  TraitMine *createItem() const override;
+  const TraitMine *createItem() const override;
 private:
+  explicit TraitFactory(trait_t trait);
+  friend ItemFactory *tileFactory(quint8 tile);
+
   trait_t trait;
 };
 
-ItemFactory *randomItemFactory();
+// A ground tile is one byte, see Ground
+enum tile_t : quint8 {
+  NO_TILE,
+  ROUND_TILE,
+  SQUARE_TILE,
+  RED_TILE,
+  BLUE_TILE,
+  NR_TILE
+};
+
+ItemFactory *tileFactory(quint8 tile); // nullptr for NO_TILE
 
 // serialize
-void saveItemFactory(QDataStream &out, ItemFactory *f);
-ItemFactory *loadItemFactory(QDataStream &in);
+// a tile as saved before tiles were bytes, its tag QChar already read
+tile_t loadTaggedTile(QDataStream &in, QChar tag);
 
+// the interned items
 const Mine *getMine(type_t type, shape_t shape, rotate_t rotate, trait_t trait);
+const TraitMine *getTraitMine(trait_t trait);
 
 #endif // ITEM_H
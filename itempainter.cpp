@@ -0,0 +1,85 @@
+#include "itempainter.h"
+
+static void paintDefault(QPainter *painter) {
+  qWarning() << "default item image is painted.";
+  painter->save();
+  painter->setPen(Qt::red);
+  painter->drawRect(QRectF(-R, -R, 2*R, 2*R));
+  painter->drawLine(-R, -R, R, R);
+  painter->drawLine(R, -R, -R, R);
+  painter->restore();
+}
+
+static void paintMine(QPainter *painter, const Mine *mine) {
+  type_t type = mine->getType();
+  shape_t shape = mine->getShape();
+  rotate_t rotate = mine->getRotate();
+  trait_t trait = mine->getTrait();
+
+  painter->save();
+  painter->setPen(QPen(Qt::darkGray, L/16));
+  painter->setBrush(QBrush(Qt::GlobalColor(trait)));
+  QRectF bound(-R, -R, 2*R, 2*R);
+  painter->rotate(-rotate * 90);
+  switch (type) {
+  case ROUND:
+//    painter->drawPie(bound, rotate * 90 * 16, shape * 90 * 16);
+    switch (shape) {
+    case FULL:
+      painter->drawPie(bound, 180*16, 90*16);
+      painter->drawPie(bound, 270*16, 90*16);
+    case HALF: // fall through
+      painter->drawPie(bound, 90*16, 90*16);
+    case QUARTER: // fall through
+      painter->drawPie(bound, 0, 90*16);
+    }
+
+    break;
+  case SQUARE:
+    switch (shape) {
+    case FULL:
+      painter->drawRect(QRectF(-R, 0, R, R));
+      painter->drawRect(QRectF(0, 0, R, R));
+    case HALF: // fall through
+      painter->drawRect(QRectF(-R, -R, R, R));
+    case QUARTER: // fall through
+      painter->drawRect(QRectF(0, -R, R, R));
+    }
+    break;
+  }
+  painter->restore();
+}
+
+static void paintTraitMine(QPainter *painter, const TraitMine *tmine) {
+  painter->save();
+  QString file = ":/item/";
+  switch (tmine->getTrait()) {
+  case BLACK:
+    file += "BLACK";
+    break;
+  case BLUE:
+    file += "BLUE";
+    break;
+  case RED:
+    file += "RED";
+    break;
+  }
+
+  QImage image(file);
+  if (image.isNull()) {
+    paintDefault(painter);
+  } else {
+    painter->drawImage(QRectF(-R, -R, 2*R, 2*R), image);
+  }
+  painter->restore();
+}
+
+void paintItem(QPainter *painter, const Item *item) {
+  if (auto mine = dynamic_cast<const Mine *>(item)) {
+    paintMine(painter, mine);
+  } else if (auto tmine = dynamic_cast<const TraitMine *>(item)) {
+    paintTraitMine(painter, tmine);
+  } else {
+    paintDefault(painter);
+  }
+}
@@ -0,0 +1,10 @@
+#ifndef ITEMPAINTER_H
+#define ITEMPAINTER_H
+
+#include "item.h"
+#include <QtWidgets>
+
+// items carry no drawing code, the GUI paints them centered at the origin
+void paintItem(QPainter *painter, const Item *item);
+
+#endif // ITEMPAINTER_H
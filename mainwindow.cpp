@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "itempainter.h"
 
 MainWindow::MainWindow(bool newGame, QString filename, QWidget *parent)
     : QMainWindow(parent), filename(filename) {
@@ -7,6 +8,7 @@ MainWindow::MainWindow(bool newGame, QString filename, QWidget *parent)
   itemLabel = new QLabel("0 / 0", this);
   enhanceLabel = new QLabel("Local Enhance: 0", this);
   moneyLabel = new QLabel("Money: 0", this);
+  speedLabel = new QLabel("Speed: 1x", this);
 
   if (newGame) {
     game = new GameState(32, 24, scene, goal, this);
@@ -37,6 +39,7 @@ MainWindow::MainWindow(bool newGame, QString filename, QWidget *parent)
   right->addWidget(itemLabel);
 
   right->addWidget(enhanceLabel);
+  right->addWidget(speedLabel);
 
   addDeviceRatios(right);
 
@@ -66,18 +69,24 @@ MainWindow::MainWindow(bool newGame, QString filename, QWidget *parent)
   connect(game, &GameState::zoomIn, this, &MainWindow::zoomIn);
   connect(game, &GameState::zoomOut, this, &MainWindow::zoomOut);
   connect(game, &GameState::zoomReset, this, &MainWindow::zoomReset);
+  connect(game, &GameState::speedChangeEvent, this,
+          &MainWindow::speedChangeEvent);
 
   game->init();
 }
 
 MainWindow::~MainWindow() {}
 
-void MainWindow::updateGoal(int problemSet, int task, int received, int required, const QPicture *icon)
+void MainWindow::updateGoal(int problemSet, int task, int received, int required, const Item *goal)
 {
   using std::to_string;
   problemLabel->setText(("ProblemSet " + to_string(problemSet)).c_str());
   taskLabel->setText(("Task " + to_string(task)).c_str());
-  itemLabel->setPicture(*icon);
+  goalIcon = QPicture();
+  QPainter painter(&goalIcon);
+  paintItem(&painter, goal);
+  painter.end();
+  itemLabel->setPicture(goalIcon);
   itemLabel->setText((to_string(received) + " / " + to_string(required)).c_str());
 }
 
@@ -142,6 +151,13 @@ void MainWindow::zoomReset()
   view->resetTransform();
 }
 
+void MainWindow::speedChangeEvent(int speed)
+{
+  using std::to_string;
+  this->speedLabel->setText(
+      speed ? ("Speed: " + to_string(speed) + "x").c_str() : "Speed: max");
+}
+
 void MainWindow::addDeviceButtons(QHBoxLayout *dButtons)
 {
   QIcon minerIcon(":/device_icon/miner");
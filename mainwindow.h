@@ -15,7 +15,7 @@ public:
 signals:
 
 public slots:
-  void updateGoal(int problemSet, int task, int received, int required, const QPicture *icon);
+  void updateGoal(int problemSet, int task, int received, int required, const Item *goal);
   void deviceChangeEvent(device_id_t id);
   void deviceRatioUpdateEvent(device_id_t id, qreal ratio);
   void saveEvent();
@@ -24,6 +24,7 @@ public slots:
   void zoomIn();
   void zoomOut();
   void zoomReset();
+  void speedChangeEvent(int speed);
 
 private:
   void addDeviceButtons(QHBoxLayout *l);
@@ -40,7 +41,8 @@ private:
   QList<QLabel *> deviceRatioLabels;
   QLabel *moneyLabel, *enhanceLa;
 
-  QLabel *problemLabel, *taskLabel, *itemLabel, *enhanceLabel;
+  QLabel *problemLabel, *taskLabel, *itemLabel, *enhanceLabel, *speedLabel;
+  QPicture goalIcon;
 };
 
 #endif // MAINWINDOW_H
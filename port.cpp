@@ -1,90 +1,250 @@
 #include "port.h"
+#include "devicemodel.h"
+#include "taskpool.h"
 
-InputPort::InputPort() : otherPort(nullptr) {}
+Port::Port(kind_t kind) : kind_(kind), graph(nullptr), id_(-1) {}
 
-InputPort::~InputPort() {
-  if (otherPort) {
-    otherPort->disconnect();
-  }
-}
+Port::kind_t Port::kind() const { return kind_; }
 
-bool InputPort::ready() const
-{
-  return otherPort && otherPort->valid();
-}
+int Port::id() const { return id_; }
 
-const Item *InputPort::receive() {
-  if (otherPort && otherPort->valid()) {
-    return otherPort->transmit();
-  } else {
+DeviceModel *Port::getOwner() const {
+  if (id_ < 0) {
     return nullptr;
   }
+  return kind_ == INPUT ? graph->inputOwner_[id_] : graph->outputOwner_[id_];
 }
 
-void InputPort::connect(Port *o) {
-  if (o == otherPort)
-    return;
-  if (otherPort) {
-    otherPort->disconnect();
+DeviceModel *Port::getPeerOwner() const {
+  if (id_ < 0) {
+    return nullptr;
+  }
+  if (kind_ == INPUT) {
+    int o = graph->producer_[id_];
+    return o >= 0 ? graph->outputOwner_[o] : nullptr;
+  } else {
+    int i = graph->consumer_[id_];
+    return i >= 0 ? graph->inputOwner_[i] : nullptr;
   }
-  otherPort = dynamic_cast<OutputPort *>(o);
 }
 
-void InputPort::disconnect() { otherPort = nullptr; }
+InputPort::InputPort() : Port(INPUT) {}
 
-OutputPort::OutputPort() : otherPort(nullptr), buffer(nullptr) {}
+bool InputPort::ready() const
+{
+  if (id_ < 0) {
+    return false;
+  }
+  int o = graph->producer_[id_];
+  return o >= 0 && graph->buffer[o] && !graph->taken[o];
+}
 
-OutputPort::~OutputPort() {
-  if (buffer) {
-    delete buffer;
+const Item *InputPort::receive() {
+  if (!ready()) {
+    return nullptr;
   }
-  if (otherPort) {
-    otherPort->disconnect();
+  int o = graph->producer_[id_];
+  const Item *ret = graph->buffer[o];
+  if (graph->ticking) {
+    graph->taken[o] = true;
+    graph->touch(o);
+  } else {
+    graph->buffer[o] = nullptr;
   }
+  graph->wakeLater(graph->outputOwner_[o]);
+  return ret;
 }
 
+OutputPort::OutputPort() : Port(OUTPUT) {}
+
 bool OutputPort::send(const Item *item) {
-  if (!item) {
+  if (!item || !ready()) {
     return false;
   }
-  if (buffer) {
-    return false;
+  if (graph->ticking) {
+    graph->staged[id_] = item;
+    graph->touch(id_);
+  } else {
+    graph->buffer[id_] = item;
+  }
+  int i = graph->consumer_[id_];
+  if (i >= 0) {
+    graph->wakeLater(graph->inputOwner_[i]);
   }
-  buffer = item;
   return true;
 }
 
 bool OutputPort::ready() const
 {
-  return buffer == nullptr;
+  return id_ >= 0 && graph->buffer[id_] == nullptr &&
+         graph->staged[id_] == nullptr;
 }
 
-const Item *OutputPort::getBuffer()
+const Item *OutputPort::getBuffer() const
 {
-  return buffer;
+  return id_ >= 0 ? graph->buffer[id_] : nullptr;
 }
 
 bool OutputPort::valid() const
 {
-  return buffer != nullptr;
+  return id_ >= 0 && graph->buffer[id_] != nullptr && !graph->taken[id_];
 }
 
 const Item *OutputPort::transmit() {
-  const Item *ret = buffer;
-  buffer = nullptr;
+  // only used outside of ticks, see BeltPath::merge
+  assert(!graph || !graph->ticking);
+  const Item *ret = getBuffer();
+  if (ret) {
+    graph->buffer[id_] = nullptr;
+    graph->outputOwner_[id_]->wake();
+  }
   return ret;
 }
 
-void OutputPort::connect(Port *o) {
-  if (otherPort) {
-    otherPort->disconnect();
+PortGraph::PortGraph() : ticking(false) {}
+
+void PortGraph::beginTick(int workers) {
+  assert(!ticking && workers >= 1);
+  ticking = true;
+  if ((int)dirty.size() < workers) {
+    dirty.resize(workers);
+    wakes.resize(workers);
+  }
+}
+
+void PortGraph::commit() {
+  assert(ticking);
+  for (auto &list : dirty) {
+    for (int o : list) {
+      if (taken[o]) {
+        buffer[o] = nullptr;
+        taken[o] = false;
+      }
+      if (staged[o]) {
+        assert(!buffer[o]);
+        buffer[o] = staged[o];
+        staged[o] = nullptr;
+      }
+    }
+    list.clear();
+  }
+  ticking = false;
+  // devices put to sleep during the tick learn about it now
+  for (auto &list : wakes) {
+    for (auto dev : list) {
+      dev->wake();
+    }
+    list.clear();
+  }
+}
+
+void PortGraph::touch(int output) {
+  dirty[TaskPool::workerIndex()].push_back(output);
+}
+
+void PortGraph::wakeLater(DeviceModel *device) {
+  if (ticking) {
+    wakes[TaskPool::workerIndex()].push_back(device);
+  } else {
+    device->wake();
+  }
+}
+
+void PortGraph::attach(Port *port, DeviceModel *owner) {
+  assert(port->id_ < 0 && owner);
+  port->graph = this;
+  if (port->kind_ == Port::OUTPUT) {
+    if (freeOutputs.empty()) {
+      port->id_ = buffer.size();
+      buffer.push_back(nullptr);
+      staged.push_back(nullptr);
+      taken.push_back(false);
+      consumer_.push_back(-1);
+      outputOwner_.push_back(owner);
+    } else {
+      port->id_ = freeOutputs.back();
+      freeOutputs.pop_back();
+      outputOwner_[port->id_] = owner;
+    }
+  } else {
+    if (freeInputs.empty()) {
+      port->id_ = producer_.size();
+      producer_.push_back(-1);
+      inputOwner_.push_back(owner);
+    } else {
+      port->id_ = freeInputs.back();
+      freeInputs.pop_back();
+      inputOwner_[port->id_] = owner;
+    }
+  }
+}
+
+void PortGraph::detach(Port *port) {
+  assert(port->graph == this && port->id_ >= 0 && !ticking);
+  int id = port->id_;
+  if (port->kind_ == Port::OUTPUT) {
+    if (consumer_[id] >= 0) {
+      producer_[consumer_[id]] = -1;
+    }
+    buffer[id] = nullptr;
+    consumer_[id] = -1;
+    outputOwner_[id] = nullptr;
+    freeOutputs.push_back(id);
+  } else {
+    if (producer_[id] >= 0) {
+      consumer_[producer_[id]] = -1;
+    }
+    producer_[id] = -1;
+    inputOwner_[id] = nullptr;
+    freeInputs.push_back(id);
+  }
+  port->graph = nullptr;
+  port->id_ = -1;
+}
+
+void PortGraph::connect(Port *a, Port *b) {
+  assert(a->graph == this && b->graph == this);
+  if (a->kind_ == b->kind_) {
+    return;
+  }
+  int o = (a->kind_ == Port::OUTPUT ? a : b)->id_;
+  int i = (a->kind_ == Port::INPUT ? a : b)->id_;
+  // a port has at most one edge
+  if (consumer_[o] >= 0) {
+    producer_[consumer_[o]] = -1;
   }
-  otherPort = dynamic_cast<InputPort *>(o);
+  if (producer_[i] >= 0) {
+    consumer_[producer_[i]] = -1;
+  }
+  consumer_[o] = i;
+  producer_[i] = o;
 }
 
-void OutputPort::disconnect() { otherPort = nullptr; }
+int PortGraph::outputCount() const { return buffer.size(); }
+
+int PortGraph::inputCount() const { return producer_.size(); }
+
+int PortGraph::consumer(int output) const { return consumer_[output]; }
+
+int PortGraph::producer(int input) const { return producer_[input]; }
 
-Port::~Port() {}
+DeviceModel *PortGraph::outputOwner(int output) const {
+  return outputOwner_[output];
+}
+
+DeviceModel *PortGraph::inputOwner(int input) const {
+  return inputOwner_[input];
+}
+
+QList<std::pair<int, int>> PortGraph::edges() const {
+  QList<std::pair<int, int>> ret;
+  for (int o = 0; o < (int)consumer_.size(); o++) {
+    if (consumer_[o] >= 0) {
+      ret.push_back({o, consumer_[o]});
+    }
+  }
+  return ret;
+}
 
 PortHint::PortHint(const std::array<Port *, 4> &otherPorts)
   : otherPorts(otherPorts)
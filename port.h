@@ -2,52 +2,112 @@
 #define PORT_H
 
 #include "item.h"
+#include <vector>
 
+class DeviceModel;
+class PortGraph;
+
+// A device's end of a connection. The port itself is only an id into the
+// PortGraph of the Simulation that installed the device; buffers and edges
+// live there in flat arrays. A port is detached (id -1) until its device is
+// installed.
 class Port {
 public:
-  virtual void connect(Port *otherPort) = 0;
-  virtual void disconnect() = 0;
-  virtual ~Port();
-};
+  enum kind_t { INPUT, OUTPUT };
+
+  kind_t kind() const;
+  int id() const;
+  // the device woken when this port changes state
+  DeviceModel *getOwner() const;
+  // the device at the other end, nullptr if not connected
+  DeviceModel *getPeerOwner() const;
 
-class InputPort;
-class OutputPort;
+protected:
+  friend class PortGraph;
+  explicit Port(kind_t kind);
+
+  kind_t kind_;
+  PortGraph *graph;
+  int id_;
+};
 
 class InputPort : public Port {
 public:
   explicit InputPort();
-  ~InputPort();
   // interface for device
   bool ready() const;
   const Item *receive();
-
-  // Port interface
-  void connect(Port *otherPort) override;
-  void disconnect() override;
-
-private:
-  OutputPort *otherPort;
 };
 
 class OutputPort : public Port {
 public:
   explicit OutputPort();
-  ~OutputPort();
   // interface for device
   bool send(const Item *item);
   bool ready() const;
-  const Item *getBuffer();
-  // interface for otherPort
+  const Item *getBuffer() const;
+  // interface for the connected input
   bool valid() const;
   const Item *transmit();
+};
 
-  // Port interface
-  void connect(Port *otherPort) override;
-  void disconnect() override;
+// The port network: outputs and inputs are slots in parallel arrays, an edge
+// is the consumer of an output and the producer of an input. Handing over an
+// item is a write and a read of buffer.
+//
+// During a tick (beginTick() to commit()) every device sees the buffers as
+// they were when the tick began: a send is staged and a take only marks the
+// buffer, both become visible, and wake their peers, at commit(). A buffer
+// has one writer, which only acts on an empty buffer, and one reader, which
+// only acts on a full one, so the result does not depend on the order the
+// devices are ticked in, and devices that share no port can be ticked on
+// different threads; each TaskPool worker records its events separately.
+class PortGraph {
+public:
+  explicit PortGraph();
+
+  // timing
+  void beginTick(int workers = 1); // TaskPool::size() of the ticking pool
+  void commit();
+
+  // editing
+  void attach(Port *port, DeviceModel *owner); // gives the port an id
+  void detach(Port *port); // drops its edge and the item it buffers
+  void connect(Port *a, Port *b); // only an output to an input connects
+
+  // queries
+  int outputCount() const; // ids are below these, freed ids are reused
+  int inputCount() const;
+  int consumer(int output) const; // -1 for none
+  int producer(int input) const;
+  DeviceModel *outputOwner(int output) const; // nullptr for a free id
+  DeviceModel *inputOwner(int input) const;
+  QList<std::pair<int, int>> edges() const; // (output, input)
 
 private:
-  const Item *buffer;
-  InputPort *otherPort;
+  friend class Port;
+  friend class InputPort;
+  friend class OutputPort;
+
+  void touch(int output);
+  void wakeLater(DeviceModel *device);
+
+  // by output id
+  std::vector<const Item *> buffer;
+  std::vector<const Item *> staged; // sent this tick
+  std::vector<char> taken;          // received this tick
+  std::vector<int> consumer_;
+  std::vector<DeviceModel *> outputOwner_;
+  // by input id
+  std::vector<int> producer_;
+  std::vector<DeviceModel *> inputOwner_;
+
+  std::vector<int> freeOutputs, freeInputs;
+
+  bool ticking;
+  // by TaskPool::workerIndex()
+  std::vector<std::vector<int>> dirty; // outputs with a staged send or take
+  std::vector<std::vector<DeviceModel *>> wakes;
 };
 
 class PortHint {
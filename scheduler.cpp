@@ -0,0 +1,252 @@
+#include "scheduler.h"
+#include "devicemodel.h"
+#include "taskpool.h"
+#include <algorithm>
+
+Scheduler::Scheduler() : frame_(0), awake(0) {}
+
+Scheduler::~Scheduler() {
+  auto release = [](bucket_t &b) {
+    for (auto dev : b) {
+      dev->scheduler = nullptr;
+      dev->slot = nullptr;
+    }
+  };
+  for (auto &b : level0) {
+    release(b);
+  }
+  for (auto &b : level1) {
+    release(b);
+  }
+  release(overflow);
+}
+
+qint64 Scheduler::interval(DeviceModel *device) {
+  qreal realSpeed = device->speed() * device->ratio();
+  if (realSpeed <= 0) {
+    return -1;
+  }
+  // no device is faster than one call per frame (belts at ratio 4 are
+  // exactly that)
+  return std::max(qRound64(FPS * ONE / realSpeed), ONE);
+}
+
+qint64 Scheduler::callFrame(DeviceModel *device) {
+  return (device->due + ONE - 1) >> FRAC_BITS;
+}
+
+void Scheduler::add(DeviceModel *device) {
+  assert(device->scheduler == nullptr);
+  device->scheduler = this;
+  device->interval = interval(device);
+  // the device was frameCount frames after its last call when it was removed
+  // or saved
+  qint64 now = frame_ * ONE;
+  device->due = std::max(now - device->frameCount * ONE + device->interval,
+                         now + 1);
+  if (device->interval > 0) {
+    insert(device);
+  }
+}
+
+void Scheduler::remove(DeviceModel *device) {
+  assert(device->scheduler == this);
+  sync(device);
+  if (device->slot) {
+    unlink(device);
+  }
+  device->scheduler = nullptr;
+}
+
+void Scheduler::wake(DeviceModel *device) {
+  assert(device->scheduler == this);
+  if (device->slot || device->interval <= 0) {
+    return;
+  }
+  catchUp(device);
+  insert(device);
+}
+
+void Scheduler::retime(DeviceModel *device) {
+  assert(device->scheduler == this);
+  if (device->slot) {
+    unlink(device);
+  } else if (device->interval > 0) {
+    catchUp(device);
+  }
+  qint64 now = frame_ * ONE;
+  qint64 last = device->interval > 0 ? device->due - device->interval
+                                     : now - device->frameCount * ONE;
+  device->interval = interval(device);
+  device->due = std::max(last + device->interval, now + 1);
+  // the new speed may unblock it, let next() decide
+  if (device->interval > 0) {
+    insert(device);
+  }
+}
+
+void Scheduler::sync(DeviceModel *device) {
+  if (device->interval <= 0) {
+    return;
+  }
+  catchUp(device);
+  qint64 last = device->due - device->interval;
+  device->frameCount = std::max((frame_ * ONE - last) >> FRAC_BITS, qint64(0));
+}
+
+void Scheduler::catchUp(DeviceModel *device) {
+  // a sleeping device keeps its phase, every call it missed would have been
+  // without effect
+  qint64 now = frame_ * ONE;
+  if (device->due <= now) {
+    device->due += ((now - device->due) / device->interval + 1) *
+                   device->interval;
+  }
+}
+
+void Scheduler::insert(DeviceModel *device) {
+  qint64 f = callFrame(device);
+  assert(f > frame_);
+  bucket_t *b;
+  if (f - frame_ < LEVEL0_SIZE) {
+    b = &level0[f % LEVEL0_SIZE];
+  } else if ((f >> LEVEL0_BITS) - (frame_ >> LEVEL0_BITS) < LEVEL1_SIZE) {
+    b = &level1[(f >> LEVEL0_BITS) % LEVEL1_SIZE];
+  } else {
+    b = &overflow;
+  }
+  link(device, *b);
+}
+
+void Scheduler::link(DeviceModel *device, bucket_t &b) {
+  device->slot = &b;
+  device->slotIndex = b.size();
+  b.push_back(device);
+  awake++;
+}
+
+void Scheduler::unlink(DeviceModel *device) {
+  // swap-remove, the order inside a bucket does not matter
+  bucket_t &b = *device->slot;
+  int i = device->slotIndex;
+  b[i] = b.back();
+  b[i]->slotIndex = i;
+  b.pop_back();
+  device->slot = nullptr;
+  awake--;
+}
+
+void Scheduler::cascade(bucket_t &b) {
+  bucket_t moving;
+  moving.swap(b);
+  awake -= moving.size();
+  // the first frame of a level 0 turn has started but its bucket is not
+  // taken yet, a device due in it goes there
+  for (auto dev : moving) {
+    qint64 f = callFrame(dev);
+    assert(f >= frame_);
+    if (f == frame_) {
+      link(dev, level0[frame_ % LEVEL0_SIZE]);
+    } else {
+      insert(dev);
+    }
+  }
+}
+
+Scheduler::bucket_t Scheduler::takeDue() {
+  frame_++;
+  if (frame_ % LEVEL0_SIZE == 0) {
+    if ((frame_ >> LEVEL0_BITS) % LEVEL1_SIZE == 0) {
+      cascade(overflow);
+    }
+    cascade(level1[(frame_ >> LEVEL0_BITS) % LEVEL1_SIZE]);
+  }
+
+  bucket_t current;
+  current.swap(level0[frame_ % LEVEL0_SIZE]);
+  awake -= current.size();
+  // memory order walks each DevicePool front to back, one device type after
+  // another
+  std::sort(current.begin(), current.end());
+  for (auto dev : current) {
+    dev->slot = nullptr;
+  }
+  return current;
+}
+
+bool Scheduler::call(DeviceModel *device) {
+  assert(callFrame(device) == frame_);
+  // port events of this frame only wake devices after it, see PortGraph
+  bool progress = device->next();
+  device->due += device->interval;
+  return progress;
+}
+
+void Scheduler::advance() {
+  for (auto dev : takeDue()) {
+    if (call(dev)) {
+      insert(dev);
+    }
+  }
+}
+
+void Scheduler::advance(
+    TaskPool &pool, const std::function<const void *(DeviceModel *)> &group) {
+  bucket_t current = takeDue();
+  int n = current.size();
+  if (pool.size() == 1 || n < PARALLEL_MIN) {
+    for (auto dev : current) {
+      if (call(dev)) {
+        insert(dev);
+      }
+    }
+    return;
+  }
+
+  // keep the memory order inside a group
+  std::vector<std::pair<const void *, DeviceModel *>> keyed;
+  keyed.reserve(n);
+  for (auto dev : current) {
+    keyed.push_back({group(dev), dev});
+  }
+  std::stable_sort(keyed.begin(), keyed.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  // the nullptr group sorts first, it is left out of the tasks
+  int serial = 0;
+  while (serial < n && keyed[serial].first == nullptr) {
+    serial++;
+  }
+
+  // a few tasks per thread, cut only between groups, leave room for stealing
+  // when one group is much bigger than the rest
+  int chunk = std::max((n - serial) / (pool.size() * 4), 1);
+  std::vector<char> progress(n);
+  std::vector<std::function<void()>> tasks;
+  for (int begin = serial; begin < n;) {
+    int end = std::min(begin + chunk, n);
+    while (end < n && keyed[end].first == keyed[end - 1].first) {
+      end++;
+    }
+    tasks.push_back([this, &keyed, &progress, begin, end] {
+      for (int i = begin; i < end; i++) {
+        progress[i] = call(keyed[i].second);
+      }
+    });
+    begin = end;
+  }
+  pool.run(tasks);
+  for (int i = 0; i < serial; i++) {
+    progress[i] = call(keyed[i].second);
+  }
+
+  // the wheel is only touched here, on the calling thread
+  for (int i = 0; i < n; i++) {
+    if (progress[i]) {
+      insert(keyed[i].second);
+    }
+  }
+}
+
+qint64 Scheduler::frame() const { return frame_; }
+
+int Scheduler::awakeCount() const { return awake; }
@@ -0,0 +1,77 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QtGlobal>
+#include <array>
+#include <functional>
+#include <vector>
+
+class DeviceModel;
+class TaskPool;
+
+// Calls next() on the devices that are due, through a hierarchical timing
+// wheel keyed by the frame of their next call, so a frame only touches the
+// devices firing in it.
+// Times are fixed point frames with FRAC_BITS fractional bits. A device is
+// called every FPS / (speed() * ratio()) frames without rounding the interval
+// to whole frames, so its long-run rate is exactly speed() * ratio() per sec;
+// a call lands in the first frame at or after its due time.
+// A device whose next() changed nothing is put to sleep: it leaves the wheel
+// until one of its ports wakes it (an item arrived at an input, or an output
+// was drained), then resumes at its old phase.
+// Devices of one frame may run on several threads as long as devices sharing
+// a port run on the same one, see PortGraph.
+class Scheduler {
+public:
+  static constexpr int FRAC_BITS = 24;
+  static constexpr qint64 ONE = qint64(1) << FRAC_BITS; // one frame
+
+  explicit Scheduler();
+  ~Scheduler();
+
+  void add(DeviceModel *device); // devices start awake
+  void remove(DeviceModel *device);
+  void wake(DeviceModel *device);
+  // the ratio of the device's class has changed, keep the time since its last
+  // call and compute the next one with the new interval
+  void retime(DeviceModel *device);
+  // store the device's frames since its last next() call for saving
+  void sync(DeviceModel *device);
+
+  void advance(); // one frame
+  // one frame, the due devices are split by group(), which must give devices
+  // sharing a port the same key, and the groups run on the pool; the devices
+  // of the nullptr group run after them, on the calling thread
+  void advance(TaskPool &pool,
+               const std::function<const void *(DeviceModel *)> &group);
+  qint64 frame() const;
+  int awakeCount() const;
+
+private:
+  typedef std::vector<DeviceModel *> bucket_t;
+  // level 0 holds one frame per bucket, level 1 one turn of level 0 per
+  // bucket, anything further away waits in overflow
+  static constexpr int LEVEL0_BITS = 8;
+  static constexpr int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+  static constexpr int LEVEL1_SIZE = 64;
+  // below this many due devices a frame is not worth handing out
+  static constexpr int PARALLEL_MIN = 256;
+
+  static qint64 interval(DeviceModel *device);
+  static qint64 callFrame(DeviceModel *device);
+  void insert(DeviceModel *device); // due after the current frame
+  void link(DeviceModel *device, bucket_t &b);
+  void unlink(DeviceModel *device);
+  void cascade(bucket_t &b);
+  void catchUp(DeviceModel *device);
+  bucket_t takeDue(); // starts the next frame
+  bool call(DeviceModel *device);
+
+  qint64 frame_;
+  int awake;
+  std::array<bucket_t, LEVEL0_SIZE> level0;
+  std::array<bucket_t, LEVEL1_SIZE> level1;
+  bucket_t overflow;
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,392 @@
+#include "goalmanager.h"
+#include "simulation.h"
+#include "throughput.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+// Calls next() as often as the scheduler lets it, for --check-rates.
+class RateProbe : public DeviceModel {
+public:
+  explicit RateProbe(device_id_t id) : calls(0), id(id) {}
+  PortRange ports() override { return PortRange(); }
+  Port *port(int) override { return nullptr; }
+
+  qint64 calls;
+
+protected:
+  bool next() override {
+    calls++;
+    return true;
+  }
+  qreal speed() override { return getDeviceSpeed(id); }
+  qreal ratio() override { return getDeviceRatio(id); }
+
+private:
+  device_id_t id;
+};
+
+// Runs every device class at several ratios for the given number of frames
+// and compares the number of next() calls with speed * ratio * seconds.
+static int checkRates(qint64 ticks, QTextStream &out) {
+  const qreal ratios[] = {0.5, 1, 1.25, 2.5, 4};
+  int failures = 0;
+  out << "device   ratio  expected/sec  measured/sec  calls\n";
+  for (int i = 0; i < DEV_NONE; i++) {
+    device_id_t id = device_id_t(i);
+    for (qreal ratio : ratios) {
+      resetDeviceRatio();
+      setDeviceRatio(id, ratio);
+      RateProbe probe(id);
+      {
+        Scheduler scheduler;
+        scheduler.add(&probe);
+        for (qint64 t = 0; t < ticks; t++) {
+          scheduler.advance();
+        }
+        scheduler.remove(&probe);
+      }
+      qreal seconds = qreal(ticks) / FPS;
+      qreal expected = getDeviceSpeed(id) * ratio * seconds;
+      // the last call may fall on either side of the end of the run
+      bool ok = qAbs(probe.calls - expected) <= 1;
+      if (!ok) {
+        failures++;
+      }
+      out << getDeviceName(id).leftJustified(8) << " "
+          << QString::number(ratio).leftJustified(6) << " "
+          << QString::number(expected / seconds).leftJustified(13) << " "
+          << QString::number(probe.calls / seconds).leftJustified(13) << " "
+          << probe.calls << (ok ? "" : "  MISMATCH") << "\n";
+    }
+  }
+  resetDeviceRatio();
+  return failures ? 1 : 0;
+}
+
+static QString describe(const Item *item) {
+  if (auto t = dynamic_cast<const TraitMine *>(item)) {
+    return QString("trait %1").arg(int(t->getTrait()));
+  }
+  auto m = dynamic_cast<const Mine *>(item);
+  if (!m) {
+    return "none";
+  }
+  return QString("%1 %2 r%3 trait %4")
+      .arg(m->getType() == ROUND ? "round" : "square")
+      .arg(m->getShape() == FULL   ? "full"
+           : m->getShape() == HALF ? "half"
+                                   : "quarter")
+      .arg(int(m->getRotate()))
+      .arg(int(m->getTrait()));
+}
+
+static QString describe(const Simulation &simulation, DeviceModel *device) {
+  QString name = "Center";
+  if (dynamic_cast<MinerModel *>(device)) {
+    name = getDeviceName(MINER);
+  } else if (dynamic_cast<BeltModel *>(device)) {
+    name = getDeviceName(BELT);
+  } else if (dynamic_cast<CutterModel *>(device)) {
+    name = getDeviceName(CUTTER);
+  } else if (dynamic_cast<MixerModel *>(device)) {
+    name = getDeviceName(MIXER);
+  } else if (dynamic_cast<RotatorModel *>(device)) {
+    name = getDeviceName(ROTATOR);
+  } else if (dynamic_cast<TrashModel *>(device)) {
+    name = getDeviceName(TRASH);
+  }
+  QPoint p = simulation.description(device).p;
+  return QString("%1 at (%2, %3)").arg(name).arg(p.x()).arg(p.y());
+}
+
+// Solves the save with Throughput, then simulates it and compares the
+// predicted delivery rate of every item with the one measured over the second
+// half of the run, when the belts have filled up.
+static int checkThroughput(Simulation &simulation, GoalManager &goalManager,
+                           qint64 ticks, QTextStream &out) {
+  QElapsedTimer timer;
+  timer.start();
+  Throughput throughput(simulation);
+  qint64 solveNs = timer.nsecsElapsed();
+
+  out << "solved " << simulation.devices().size() << " devices in "
+      << solveNs / 1000 << " us\n";
+  const PortGraph &graph = simulation.portGraph();
+  for (PortEntry e : simulation.center()->ports()) {
+    int producer = graph.producer(e.port->id());
+    if (producer < 0 || throughput.outputRate(producer) <= 0) {
+      continue;
+    }
+    DeviceModel *feeder = graph.outputOwner(producer);
+    out << "  " << throughput.outputRate(producer) << " items/sec from "
+        << describe(simulation, feeder) << ", bottleneck "
+        << describe(simulation, throughput.bottleneck(feeder)) << "\n";
+  }
+
+  // the task the factory is working on
+  const Item *goal = nullptr;
+  int required = 0, received = 0;
+  QObject::connect(&goalManager, &GoalManager::updateGoal,
+                   [&](int, int, int r, int n, const Item *g) {
+                     received = r;
+                     required = n;
+                     goal = g;
+                   });
+  goalManager.init();
+  if (auto ref = dynamic_cast<const Mine *>(goal)) {
+    qreal rate = 0;
+    for (auto &[item, r] : throughput.delivered()) {
+      auto mine = dynamic_cast<const Mine *>(item);
+      if (mine && *mine == *ref) {
+        rate += r;
+      }
+    }
+    out << "current task:     " << received << "/" << required << " of "
+        << describe(goal) << ", ";
+    if (rate > 0) {
+      out << "done in " << (required - received) / rate << " sec\n";
+    } else {
+      out << "never done\n";
+    }
+  }
+
+  std::map<const Item *, qint64> measured;
+  qint64 warmup = ticks / 2;
+  simulation.center()->setReceiver([&](const Item *item) {
+    measured[item]++;
+  });
+  for (qint64 t = 0; t < ticks; t++) {
+    if (t == warmup) {
+      measured.clear();
+    }
+    simulation.advance();
+  }
+  qreal seconds = qreal(ticks - warmup) / FPS;
+
+  std::map<const Item *, qreal> predicted = throughput.delivered();
+  for (auto &[item, n] : measured) {
+    predicted.insert({item, 0});
+  }
+  int failures = 0;
+  out << "item                     predicted/sec  measured/sec\n";
+  for (auto &[item, rate] : predicted) {
+    qreal expected = rate * seconds;
+    qreal got = measured.count(item) ? measured[item] : 0;
+    // belts hand items on in steps, a few may be on either side of the end
+    bool ok = qAbs(got - expected) <= 0.05 * expected + 3;
+    if (!ok) {
+      failures++;
+    }
+    out << describe(item).leftJustified(24) << " "
+        << QString::number(rate).leftJustified(14) << " "
+        << QString::number(got / seconds).leftJustified(13)
+        << (ok ? "" : "  MISMATCH") << "\n";
+  }
+  return failures ? 1 : 0;
+}
+
+// Runs the save once simulating every device and once with lines frozen as in
+// --lod, and compares what reached the center. The second run thaws all lines
+// every minute, as leaving fast-forward does, so they are frozen and thawed
+// again and again.
+static int checkSteadyState(const QByteArray &save, qint64 ticks, int threads,
+                            QTextStream &out) {
+  const qint64 cycle = 60 * FPS;
+  std::map<const Item *, qint64> delivered[2];
+  for (int lod = 0; lod < 2; lod++) {
+    QDataStream in(save);
+    Simulation simulation(in);
+    if (in.status() != QDataStream::Ok) {
+      out << "not a complete save\n";
+      return 1;
+    }
+    simulation.setThreads(threads);
+    simulation.setSteadyState(lod);
+    simulation.center()->setReceiver([&](const Item *item) {
+      delivered[lod][item]++;
+    });
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 t = 0; t < ticks; t++) {
+      if (lod && t > 0 && t % cycle == 0) {
+        simulation.setSteadyState(false);
+        simulation.setSteadyState(true);
+      }
+      simulation.advance();
+    }
+    out << (lod ? "lod:   " : "plain: ") << timer.nsecsElapsed() / 1000000
+        << " ms, " << simulation.frozenCount() << " devices frozen at the end\n";
+  }
+
+  for (auto &[item, n] : delivered[1]) {
+    delivered[0].insert({item, 0});
+  }
+  int failures = 0;
+  out << "item                     plain        lod\n";
+  for (auto &[item, n] : delivered[0]) {
+    qint64 got = delivered[1].count(item) ? delivered[1][item] : 0;
+    // a thawed line picks up where it stopped, in a phase of its own
+    bool ok = qAbs(got - n) <= 0.01 * n + 3;
+    if (!ok) {
+      failures++;
+    }
+    out << describe(item).leftJustified(24) << " "
+        << QString::number(n).leftJustified(12) << " " << got
+        << (ok ? "" : "  MISMATCH") << "\n";
+  }
+  return failures ? 1 : 0;
+}
+
+// cshapez-sim: loads a save written by GameState::save and runs it headless,
+// as fast as the CPU allows, then reports what reached the center.
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("cshapez-sim");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Simulates a CShapeZ save without rendering or frame pacing.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("save", "Save file written by the game.");
+  QCommandLineOption ticksOption(
+      QStringList({"n", "ticks"}),
+      "Number of frames to simulate, one frame is 1/FPS sec of game time "
+      "(default: one hour).",
+      "ticks", QString::number(3600 * FPS));
+  parser.addOption(ticksOption);
+  QCommandLineOption ratesOption(
+      "check-rates", "Check the long-run next() rate of every device class "
+                     "against its speed constant instead of running a save.");
+  parser.addOption(ratesOption);
+  QCommandLineOption threadsOption(
+      QStringList({"j", "threads"}),
+      "Threads ticking the connected components of the factory "
+      "(default: one per core).",
+      "threads", "0");
+  parser.addOption(threadsOption);
+  QCommandLineOption throughputOption(
+      "throughput", "Predict the steady-state delivery rate of every item "
+                    "without simulating, then check it against the run.");
+  parser.addOption(throughputOption);
+  QCommandLineOption offlineOption(
+      "offline",
+      "Credit secs of offline time at the factory's steady-state rates "
+      "before simulating, the way the game does when a save is loaded.",
+      "secs", "0");
+  parser.addOption(offlineOption);
+  QCommandLineOption lodOption(
+      "lod", "Freeze production lines once they have settled and credit "
+             "their measured rates instead of simulating them, as the game "
+             "does when fast-forwarding.");
+  parser.addOption(lodOption);
+  QCommandLineOption lodCheckOption(
+      "check-lod", "Run the save with and without --lod, freezing and "
+                   "thawing the lines every minute, and check that the same "
+                   "items reach the center.");
+  parser.addOption(lodCheckOption);
+  parser.process(app);
+
+  QTextStream out(stdout), err(stderr);
+  bool ok;
+  qint64 ticks = parser.value(ticksOption).toLongLong(&ok);
+  if (!ok || ticks < 0) {
+    err << "invalid tick count: " << parser.value(ticksOption) << "\n";
+    return 1;
+  }
+  int threads = parser.value(threadsOption).toInt(&ok);
+  if (!ok || threads < 0) {
+    err << "invalid thread count: " << parser.value(threadsOption) << "\n";
+    return 1;
+  }
+  qint64 offline = parser.value(offlineOption).toLongLong(&ok);
+  if (!ok || offline < 0) {
+    err << "invalid offline time: " << parser.value(offlineOption) << "\n";
+    return 1;
+  }
+  if (parser.isSet(ratesOption)) {
+    return checkRates(ticks, out);
+  }
+  const QStringList args = parser.positionalArguments();
+  if (args.size() != 1) {
+    parser.showHelp(1);
+  }
+
+  QFile saveslot(args[0]);
+  if (!saveslot.open(QIODevice::ReadOnly)) {
+    err << "cannot open " << args[0] << ": " << saveslot.errorString() << "\n";
+    return 1;
+  }
+  if (parser.isSet(lodCheckOption)) {
+    return checkSteadyState(saveslot.readAll(), ticks, threads, out);
+  }
+  QDataStream in(&saveslot);
+  Simulation simulation(in);
+  simulation.setThreads(threads);
+  simulation.setSteadyState(parser.isSet(lodOption));
+  GoalManager goalManager(in);
+  int money, enhance, nextW, nextH;
+  qreal moneyRatio, itemRatio;
+  in >> money >> enhance >> moneyRatio >> itemRatio >> nextW >> nextH;
+  saveslot.close();
+  if (in.status() != QDataStream::Ok) {
+    err << args[0] << " is not a complete save\n";
+    return 1;
+  }
+
+  if (parser.isSet(throughputOption)) {
+    return checkThroughput(simulation, goalManager, ticks, out);
+  }
+
+  // credit the same way GameState does
+  qint64 delivered = 0, problemSets = 0;
+  int startMoney = money, startEnhance = enhance;
+  simulation.center()->setReceiver([&](const Item *item) {
+    delivered++;
+    goalManager.receiveItem(item);
+  });
+  QObject::connect(&goalManager, &GoalManager::moneyChange,
+                   [&](int delta) { money += delta * moneyRatio; });
+  QObject::connect(&goalManager, &GoalManager::enhanceChange,
+                   [&]() { enhance++; });
+  QObject::connect(&goalManager, &GoalManager::mapConstructEvent,
+                   [&]() { problemSets++; });
+
+  qreal credited = 0;
+  qint64 creditNs = 0;
+  if (offline > 0) {
+    QElapsedTimer timer;
+    timer.start();
+    Throughput throughput(simulation);
+    credited = goalManager.receiveRates(throughput.delivered(), offline);
+    creditNs = timer.nsecsElapsed();
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  for (qint64 i = 0; i < ticks; i++) {
+    simulation.advance();
+  }
+  qint64 elapsed = timer.nsecsElapsed();
+
+  qreal seconds = elapsed / 1e9;
+  out << "devices:          " << simulation.devices().size() << " ("
+      << simulation.awakeCount() << " awake, " << simulation.frozenCount()
+      << " frozen at the end)\n";
+  out << "ticks:            " << ticks << " (" << ticks / FPS
+      << " sec of game time)\n";
+  if (offline > 0) {
+    out << "offline credit:   " << credited << " of " << offline
+        << " sec, in " << creditNs / 1000 << " us\n";
+  }
+  out << "items delivered:  " << delivered << "\n";
+  out << "money earned:     " << money - startMoney << "\n";
+  out << "enhance earned:   " << enhance - startEnhance << "\n";
+  out << "problem sets:     " << problemSets << " completed\n";
+  out << "wall time:        " << seconds << " sec\n";
+  out << "ticks per second: "
+      << (seconds > 0 ? ticks / seconds : qreal(0)) << "\n";
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include "simthread.h"
+
+bool BeltState::operator==(const BeltState &o) const {
+  return outBuffer == o.outBuffer && items == o.items;
+}
+
+bool BeltState::operator!=(const BeltState &o) const { return !(*this == o); }
+
+SimThread::SimThread(Simulation *simulation,
+                     std::function<void(Snapshot &)> capture, QObject *parent)
+    : QThread(parent), simulation(simulation), capture(capture), posted(0),
+      done(0), paused(false), stopping(false), speed(1) {
+  assert(simulation);
+}
+
+SimThread::~SimThread() { stop(); }
+
+void SimThread::post(edit_t edit) {
+  QMutexLocker locker(&lock);
+  edits.push_back(edit);
+  posted++;
+  changed.wakeAll();
+}
+
+void SimThread::call(edit_t edit) {
+  if (!isRunning()) {
+    edit(*simulation);
+    return;
+  }
+  QMutexLocker locker(&lock);
+  edits.push_back(edit);
+  quint64 ticket = ++posted;
+  changed.wakeAll();
+  while (done < ticket) {
+    applied.wait(&lock);
+  }
+}
+
+void SimThread::setPaused(bool paused) {
+  QMutexLocker locker(&lock);
+  this->paused = paused;
+  changed.wakeAll();
+}
+
+void SimThread::setSpeed(int speed) {
+  assert(speed >= 0);
+  QMutexLocker locker(&lock);
+  this->speed = speed;
+  changed.wakeAll();
+}
+
+void SimThread::stop() {
+  {
+    QMutexLocker locker(&lock);
+    stopping = true;
+    changed.wakeAll();
+  }
+  wait();
+}
+
+const Snapshot &SimThread::snapshot() { return snapshots.front(); }
+
+void SimThread::run() {
+  const qint64 FRAME_NS = 1000000000 / FPS;
+  QElapsedTimer clock;
+  clock.start();
+  qint64 due = 0; // of the next frame
+  for (;;) {
+    QList<edit_t> batch;
+    int ticks, speed;
+    {
+      QMutexLocker locker(&lock);
+      for (;;) {
+        if (stopping) {
+          return;
+        }
+        qint64 left = this->speed ? due - clock.nsecsElapsed() : 0;
+        if (!edits.empty() || (!paused && left <= 0)) {
+          break;
+        }
+        if (paused) {
+          changed.wait(&lock);
+          // resume at once, without catching up on the pause
+          due = clock.nsecsElapsed();
+        } else {
+          changed.wait(&lock, (left + 999999) / 1000000);
+        }
+      }
+      batch.swap(edits);
+      speed = this->speed;
+      if (paused) {
+        ticks = 0;
+      } else if (speed == 0) {
+        ticks = FAST_BATCH;
+      } else {
+        ticks = due <= clock.nsecsElapsed() ? speed : 0;
+      }
+    }
+
+    for (auto &edit : batch) {
+      edit(*simulation);
+    }
+    if (!batch.empty()) {
+      QMutexLocker locker(&lock);
+      done += batch.size();
+      applied.wakeAll();
+    }
+
+    for (int i = 0; i < ticks; i++) {
+      simulation->advance();
+    }
+    if (speed == 0) {
+      // nobody looks at the snapshots, see setSpeed()
+      due = clock.nsecsElapsed();
+      continue;
+    }
+    if (ticks) {
+      // a late frame shifts the ones after it instead of being caught up
+      due = std::max(due + FRAME_NS, clock.nsecsElapsed());
+    }
+    capture(snapshots.back());
+    snapshots.publish();
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include "simulation.h"
+#include "triplebuffer.h"
+#include <QtCore>
+#include <functional>
+#include <unordered_map>
+
+// What a belt view paints, copied out of the model after a frame. Items are
+// interned and never freed, the pointers are valid on any thread.
+struct BeltState {
+  QList<QPair<const Item *, int>> items;
+  const Item *outBuffer = nullptr;
+  quint64 stamp = 0; // BeltPath::stamp() of the items, not compared
+
+  bool operator==(const BeltState &o) const;
+  bool operator!=(const BeltState &o) const;
+};
+
+// The moving parts of the factory after one frame, keyed by view serial
+// (see GameState) rather than by model, since a removed model's memory is
+// reused while older snapshots still mention it.
+struct Snapshot {
+  std::unordered_map<quint64, BeltState> belts;
+};
+
+// Runs a Simulation on its own thread at FPS * speed frames per sec. While
+// the thread runs nothing else touches the simulation: edits are queued with
+// post() and applied between two frames, and each frame is handed to the GUI
+// as a Snapshot through a triple buffer, so a slow paint no longer delays
+// a frame and a slow frame no longer delays input.
+class SimThread : public QThread {
+public:
+  typedef std::function<void(Simulation &)> edit_t;
+
+  // capture() fills a snapshot on the simulation thread
+  explicit SimThread(Simulation *simulation,
+                     std::function<void(Snapshot &)> capture,
+                     QObject *parent = nullptr);
+  ~SimThread();
+
+  void post(edit_t edit);
+  void call(edit_t edit); // post() and wait until it has been applied
+  void setPaused(bool paused);
+  // speed frames per displayed frame, one snapshot after them; 0 runs frames
+  // back to back and publishes no snapshots until the speed is set again
+  void setSpeed(int speed);
+  void stop();
+  // the newest snapshot, valid until the next call
+  const Snapshot &snapshot();
+
+protected:
+  void run() override;
+
+private:
+  // frames between two looks at the queue when running as fast as possible
+  static constexpr int FAST_BATCH = 64;
+
+  Simulation *simulation;
+  std::function<void(Snapshot &)> capture;
+  TripleBuffer<Snapshot> snapshots;
+
+  QMutex lock;
+  QWaitCondition changed; // an edit was posted, or a setting changed
+  QWaitCondition applied;
+  QList<edit_t> edits;
+  quint64 posted, done; // edits
+  bool paused, stopping;
+  int speed;
+};
+
+#endif // SIMTHREAD_H
@@ -0,0 +1,440 @@
+#include "simulation.h"
+
+Simulation::Simulation(int w, int h, qreal itemRatio)
+    : w(w), h(h), ground_(rng.generate(), itemRatio), center_(nullptr),
+      steady(*this, scheduler), ratioGeneration(-1), pool(new TaskPool),
+      componentsDirty(false), editDepth(0) {
+  assert(w >= 8 && h >= 8);
+  deviceMap.reset(w, h);
+  for (auto &grid : portMap) {
+    grid.reset(w, h);
+  }
+
+  center_ = new CenterModel(4);
+  installCenter();
+  resetDeviceRatio();
+}
+
+Simulation::~Simulation() {
+  removeHook = nullptr;
+  std::vector<DeviceModel *> devList;
+  for (auto &[dev, desc] : devices_) {
+    devList.push_back(dev);
+  }
+  beginEdit();
+  for (auto dev : devList) {
+    removeDevice(dev);
+  }
+  endEdit();
+}
+
+Simulation::Simulation(QDataStream &in)
+    : center_(nullptr), steady(*this, scheduler), ratioGeneration(-1),
+      pool(new TaskPool), componentsDirty(false), editDepth(0) {
+  loadMap(in);
+
+  int nr_device;
+  in >> nr_device;
+  // sanity check
+  assert(nr_device >= 0);
+
+  QList<std::pair<DeviceModel *, std::pair<QPoint, rotate_t>>> loaded;
+  for (int i = 0; i < nr_device; i++) {
+    QPoint base;
+    rotate_t rotate;
+    in >> base >> rotate;
+    DeviceModel *dev = loadDevice(in);
+    loaded.push_back({dev, {base, rotate}});
+  }
+
+  beginEdit();
+  for (auto &[dev, desc] : loaded) {
+    assert(dev);
+    if (auto c = dynamic_cast<CenterModel *>(dev)) {
+      center_ = c;
+    }
+    installDevice(desc.first, desc.second, dev);
+    restoreDevice(dev, ground(desc.first));
+  }
+  endEdit();
+  loadDeviceRatio(in);
+
+  assert(center_);
+}
+
+void Simulation::save(QDataStream &out) {
+  // frozen devices are not scheduled, and a save holds no frozen lines
+  steady.thawAll();
+  out << w << h;
+  out << QChar('G'); // generated ground, see loadMap()
+  ground_.save(out);
+
+  out << (int)devices_.size();
+  for (auto &[p, desc] : devices_) {
+    scheduler.sync(p);
+    out << desc.p << desc.r;
+    saveDevice(out, p);
+  }
+  saveDeviceRatio(out);
+}
+
+void Simulation::advance() {
+  if (ratioGeneration != deviceRatioGeneration()) {
+    steady.thawAll();
+    for (auto &[dev, desc] : devices_) {
+      scheduler.retime(dev);
+    }
+    ratioGeneration = deviceRatioGeneration();
+  }
+  if (componentsDirty) {
+    rebuildComponents();
+  }
+  // devices exchange items through the graph, which keeps the frame's
+  // transfers until every due device has run
+  graph.beginTick(pool->size());
+  // the center reads the buffers of its inputs once every line has run,
+  // before they are committed, so it needs no lock
+  scheduler.advance(*pool, [this](DeviceModel *dev) -> const void * {
+    return dev == center_ ? nullptr : component(dev);
+  });
+  graph.commit();
+  steady.advance();
+  if (center_) {
+    center_->deliver();
+  }
+}
+
+int Simulation::awakeCount() const { return scheduler.awakeCount(); }
+
+void Simulation::setThreads(int threads) { pool.reset(new TaskPool(threads)); }
+
+void Simulation::setSteadyState(bool enabled) { steady.setEnabled(enabled); }
+
+int Simulation::frozenCount() const { return steady.frozenCount(); }
+
+DeviceModel *Simulation::component(DeviceModel *device) {
+  auto it = componentParent.find(device);
+  assert(it != componentParent.end());
+  // path halving
+  while (it->second != it->first) {
+    auto parent = componentParent.find(it->second);
+    it->second = parent->second;
+    it = componentParent.find(it->second);
+  }
+  return it->first;
+}
+
+void Simulation::unite(DeviceModel *a, DeviceModel *b) {
+  if (componentsDirty) {
+    return; // the rebuild sees the edge
+  }
+  if (a == center_ || b == center_) {
+    return; // it runs after the components, see advance()
+  }
+  auto ra = component(a), rb = component(b);
+  if (ra != rb) {
+    componentParent[ra] = rb;
+  }
+}
+
+void Simulation::rebuildComponents() {
+  componentParent.clear();
+  componentsDirty = false;
+  for (auto &[dev, desc] : devices_) {
+    componentParent[dev] = dev;
+  }
+  for (auto [o, i] : graph.edges()) {
+    unite(graph.outputOwner(o), graph.inputOwner(i));
+  }
+}
+
+void Simulation::loadMap(QDataStream &in) {
+  in >> w >> h;
+
+  deviceMap.reset(w, h);
+  for (auto &grid : portMap) {
+    grid.reset(w, h);
+  }
+
+  QChar tag;
+  in >> tag;
+  if (tag == 'G') {
+    ground_ = Ground(in);
+    return;
+  }
+  // older saves hold every tile of the map, the world around it is
+  // generated with the default richness of a new game
+  ground_ = Ground(rng.generate(), 0.2);
+  if (tag == 'B') {
+    std::vector<tile_t> tiles(w * h);
+    in.readRawData(reinterpret_cast<char *>(tiles.data()), tiles.size());
+    for (int i = 0; i < w; i++) {
+      for (int j = 0; j < h; j++) {
+        assert(tiles[i * h + j] < NR_TILE);
+        ground_.setTile(i, j, tiles[i * h + j]);
+      }
+    }
+  } else {
+    // even older saves tag every tile
+    for (int i = 0; i < w; i++) {
+      for (int j = 0; j < h; j++) {
+        if (i > 0 || j > 0) {
+          in >> tag;
+        }
+        ground_.setTile(i, j, loadTaggedTile(in, tag));
+      }
+    }
+  }
+}
+
+void Simulation::beginEdit() { editDepth++; }
+
+void Simulation::endEdit() {
+  assert(editDepth > 0);
+  if (--editDepth > 0) {
+    return;
+  }
+  std::vector<BeltModel *> removedBelts;
+  for (auto device : removed) {
+    if (auto belt = dynamic_cast<BeltModel *>(device)) {
+      removedBelts.push_back(belt);
+    }
+  }
+  BeltModel::editPaths(removedBelts, installedBelts);
+  installedBelts.clear();
+  for (auto device : removed) {
+    delete device;
+  }
+  removed.clear();
+}
+
+bool Simulation::installDevice(QPoint base, rotate_t rotate,
+                               DeviceModel *device) {
+  assert(device);
+  auto blocks = device->blocks();
+  auto portEntries = device->ports();
+
+  // check bound
+  for (auto &block : blocks) {
+    auto p = mapToMap(block, base, rotate);
+    if (!inRange(p)) {
+      return false;
+    }
+    if (dynamic_cast<CenterModel *>(deviceMap.get(p))) {
+      return false;
+    }
+  }
+
+  beginEdit();
+  // allocating blocks
+  for (auto &block : blocks) {
+    auto p = mapToMap(block, base, rotate);
+
+    if (auto d = deviceMap.get(p)) {
+      removeDevice(d);
+    }
+    deviceMap.set(p, device);
+  }
+
+  scheduler.add(device);
+  componentParent[device] = device;
+
+  // connecting ports
+  for (auto [port, block, portRotate] : portEntries) {
+    graph.attach(port, device);
+
+    rotate_t r = rotate_t((rotate + portRotate) % 4);
+    auto p = mapToMap(block, base, rotate);
+
+    assert(portMap[r].get(p) == nullptr);
+    portMap[r].set(p, port);
+
+    Port *op = otherPort(p, r);
+    if (op) {
+      steady.thaw(op->getOwner());
+      graph.connect(port, op);
+      if (port->kind() != op->kind()) {
+        unite(device, op->getOwner());
+      }
+      // a new neighbour may unblock a device that went to sleep
+      op->getOwner()->wake();
+    }
+  }
+
+  device->id_ = devices_.insert({device, {base, rotate}});
+  steady.invalidate();
+  if (auto belt = dynamic_cast<BeltModel *>(device)) {
+    installedBelts.push_back(belt);
+  }
+  endEdit();
+  return true;
+}
+
+void Simulation::removeDevice(DeviceModel *device) {
+  // a copy, erasing moves another device into its place
+  const auto [base, rotate] = description(device);
+  auto blocks = device->blocks();
+  auto portEntries = device->ports();
+  // its neighbours are in its line, unless they are the center
+  steady.thaw(device);
+  steady.invalidate();
+  beginEdit();
+
+  // disconnecting ports
+  for (auto [port, block, portRotate] : portEntries) {
+    rotate_t r = rotate_t((rotate + portRotate) % 4);
+    auto p = mapToMap(block, base, rotate);
+
+    assert(portMap[r].get(p));
+    portMap[r].set(p, nullptr);
+
+    graph.detach(port);
+  }
+
+  // freeing blocks
+  for (auto &block : blocks) {
+    auto p = mapToMap(block, base, rotate);
+    assert(inRange(p));
+
+    deviceMap.set(p, nullptr);
+  }
+
+  devices_.erase(device->id());
+  scheduler.remove(device);
+  componentParent.erase(device);
+  componentsDirty = true;
+
+  if (removeHook) {
+    removeHook(device);
+  }
+  if (device == center_) {
+    center_ = nullptr;
+  }
+  removed.push_back(device);
+  endEdit();
+}
+
+void Simulation::clear(QRect rect) {
+  beginEdit();
+  rect = rect.intersected(QRect(0, 0, w, h));
+  for (int x = rect.left(); x <= rect.right(); x++) {
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+      DeviceModel *d = deviceMap.get(x, y);
+      if (d && d != center_) {
+        removeDevice(d);
+      }
+    }
+  }
+  endEdit();
+}
+
+void Simulation::setRemoveHook(std::function<void(DeviceModel *)> hook) {
+  removeHook = hook;
+}
+
+void Simulation::grow(int w, int h, qreal itemRatio) {
+  assert(w >= this->w && h >= this->h);
+  this->w = w;
+  this->h = h;
+  deviceMap.grow(w, h);
+  for (auto &grid : portMap) {
+    grid.grow(w, h);
+  }
+  // miners keep their factories, and a richer ground keeps every resource
+  ground_.setRichness(itemRatio);
+}
+
+void Simulation::installCenter() {
+  assert(center_);
+  QPoint centerBase = {rng.bounded(w - 4), rng.bounded(h - 4)};
+  rotate_t centerRotate = R0;
+  installDevice(centerBase, centerRotate, center_);
+}
+
+int Simulation::width() const { return w; }
+
+int Simulation::height() const { return h; }
+
+bool Simulation::inRange(int x, int y) const {
+  return 0 <= x && x < w && 0 <= y && y < h;
+}
+
+bool Simulation::inRange(QPoint p) const { return inRange(p.x(), p.y()); }
+
+QPoint Simulation::mapToMap(QPoint p, QPoint base, rotate_t rotate) {
+  int bx = base.x(), by = base.y();
+  int x = p.x(), y = p.y();
+  switch (rotate) {
+  case R0:
+    return base + p;
+  case R90:
+    return QPoint(bx + y, by - x);
+  case R180:
+    return base - p;
+  case R270:
+    return QPoint(bx - y, by + x);
+  }
+  assert(false);
+  return base;
+}
+
+ItemFactory *Simulation::ground(QPoint p) {
+  return tileFactory(ground_.tile(p));
+}
+
+const Ground &Simulation::ground() const { return ground_; }
+
+DeviceModel *Simulation::deviceAt(QPoint p) { return deviceMap.get(p); }
+
+CenterModel *Simulation::center() const { return center_; }
+
+const SlotMap<std::pair<DeviceModel *, DeviceDescription>> &
+Simulation::devices() const {
+  return devices_;
+}
+
+const DeviceDescription &Simulation::description(DeviceModel *device) const {
+  return devices_[device->id()].second;
+}
+
+const PortGraph &Simulation::portGraph() const { return graph; }
+
+Port *Simulation::otherPort(QPoint p, rotate_t r) {
+  int nx = p.x() + dx[r], ny = p.y() + dy[r];
+  rotate_t nr = rotate_t((r + 2) % 4);
+  if (!inRange(nx, ny)) {
+    return nullptr;
+  }
+
+  return portMap[nr].get(nx, ny);
+}
+
+QList<PortHint> Simulation::getPortHint(QPoint base, rotate_t rotate,
+                                        const QList<QPoint> &blocks) {
+  QList<PortHint> hints;
+  for (auto p : blocks) {
+    std::array<Port *, 4> ports = {};
+
+    QPoint realp = mapToMap(p, base, rotate);
+
+    for (int d = 0; d < 4; d++) {
+      // out-of-shape check
+      QPoint np = p + QPoint(dx[d], dy[d]);
+      if (blocks.contains(np))
+        continue;
+
+      rotate_t r = rotate_t((rotate + d) % 4);
+      ports[d] = otherPort(realp, r);
+    }
+
+    hints.push_back(PortHint(ports));
+  }
+
+  return hints;
+}
+
+DeviceDescription::DeviceDescription(QPoint point, rotate_t rotate)
+    : p(point), r(rotate) {}
+
+DeviceDescription::DeviceDescription(int x, int y, rotate_t rotate)
+    : p(QPoint(x, y)), r(rotate) {}
@@ -0,0 +1,122 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "chunkgrid.h"
+#include "devicemodel.h"
+#include "ground.h"
+#include "item.h"
+#include "scheduler.h"
+#include "slotmap.h"
+#include "steadystate.h"
+#include "taskpool.h"
+#include <QtCore>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct DeviceDescription {
+  QPoint p;
+  rotate_t r;
+
+  DeviceDescription(QPoint point, rotate_t rotate);
+  DeviceDescription(int x, int y, rotate_t rotate);
+};
+
+// The factory floor without any GUI: ground, placed devices and the port
+// graph between them. The ground is unbounded, see Ground; devices are placed
+// within w x h, which grows as the game goes on. GameState drives it from its timer and mirrors it in a
+// QGraphicsScene; cshapez-sim drives it directly.
+// Devices are grouped into the connected components of the port graph without
+// the center's inputs, like the lines of SteadyState, so each line feeding the
+// center is a component of its own. A frame runs the components in parallel,
+// then the center on its own.
+class Simulation {
+public:
+  explicit Simulation(int w, int h, qreal itemRatio);
+  ~Simulation();
+
+  // serialize
+  explicit Simulation(QDataStream &in);
+  void save(QDataStream &out);
+
+  // timing
+  void advance(); // one frame
+  int awakeCount() const; // devices that were not idle or blocked
+  void setThreads(int threads); // 0 for one per core, the default
+  // freeze production lines that have settled, see SteadyState; the belts of
+  // a frozen line stand still, so it is meant for when nobody watches
+  void setSteadyState(bool enabled);
+  int frozenCount() const; // devices in frozen lines
+
+  // editing
+  // the edits between beginEdit() and endEdit() are one batch: belt paths
+  // are joined and split once for all of them at endEdit(), which also
+  // deletes the removed devices; an edit outside of a batch is a batch
+  void beginEdit();
+  void endEdit();
+  bool installDevice(QPoint base, rotate_t rotate, DeviceModel *device);
+  void removeDevice(DeviceModel *device); // the device is deleted
+  void clear(QRect rect); // removes the devices on rect but the center
+  // called with every device removeDevice() has taken off the map, before it
+  // is deleted
+  void setRemoveHook(std::function<void(DeviceModel *)> hook);
+  // to a larger w x h with the given ground richness, devices are kept
+  void grow(int w, int h, qreal itemRatio);
+
+  // queries
+  int width() const;
+  int height() const;
+  bool inRange(int x, int y) const;
+  bool inRange(QPoint p) const;
+  static QPoint mapToMap(QPoint p, QPoint base, rotate_t rotate);
+  ItemFactory *ground(QPoint p);
+  const Ground &ground() const;
+  DeviceModel *deviceAt(QPoint p);
+  QList<PortHint> getPortHint(QPoint base, rotate_t rotate,
+                              const QList<QPoint> &blocks);
+  CenterModel *center() const;
+  // in the order they were installed, but the last one takes the place of a
+  // removed one
+  const SlotMap<std::pair<DeviceModel *, DeviceDescription>> &devices() const;
+  const DeviceDescription &description(DeviceModel *device) const;
+  const PortGraph &portGraph() const;
+
+private: // helper functions
+  Port *otherPort(QPoint p, rotate_t r);
+  void loadMap(QDataStream &in);
+  void installCenter();
+  DeviceModel *component(DeviceModel *device); // the root of its set
+  void unite(DeviceModel *a, DeviceModel *b);
+  void rebuildComponents();
+
+private: // states
+  int w, h;
+
+  /* mapping */
+  Ground ground_;
+  ChunkGrid<DeviceModel *> deviceMap;
+  std::array<ChunkGrid<Port *>, 4> portMap; // by the side a port faces
+  PortGraph graph;
+
+  SlotMap<std::pair<DeviceModel *, DeviceDescription>> devices_; // by id()
+  CenterModel *center_;
+  Scheduler scheduler;
+  SteadyState steady;
+  int ratioGeneration; // deviceRatioGeneration() the devices are timed with
+  std::unique_ptr<TaskPool> pool;
+
+  // union-find over devices sharing a port; installing only joins
+  // components, removing may split one, so it marks them for a rebuild
+  std::unordered_map<DeviceModel *, DeviceModel *> componentParent;
+  bool componentsDirty;
+
+  std::function<void(DeviceModel *)> removeHook;
+
+  // the batch being edited, see beginEdit()
+  int editDepth;
+  std::vector<BeltModel *> installedBelts;
+  std::vector<DeviceModel *> removed;
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,94 @@
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <QtGlobal>
+#include <cassert>
+#include <vector>
+
+// A handle to a value in a SlotMap: its slot, and the generation of the slot
+// when the value was put there. Erasing the value bumps the generation, so a
+// handle kept past its value finds nothing instead of whatever reuses the
+// slot.
+struct SlotId {
+  quint32 index = ~0u;
+  quint32 generation = 0;
+
+  quint64 key() const { return quint64(generation) << 32 | index; }
+  bool operator==(SlotId o) const {
+    return index == o.index && generation == o.generation;
+  }
+  bool operator!=(SlotId o) const { return !(*this == o); }
+};
+
+// Values in one contiguous array, found through a table of slots: insert,
+// erase and lookup are O(1), iteration walks the array. Erasing moves the
+// last value into the hole, so the order only depends on the edits, never on
+// addresses.
+template <class T> class SlotMap {
+public:
+  SlotId insert(T value) {
+    quint32 index;
+    if (freeSlots.empty()) {
+      index = table.size();
+      table.push_back({0, 0});
+    } else {
+      index = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    Slot &slot = table[index];
+    slot.dense = values.size();
+    values.push_back(std::move(value));
+    ids.push_back({index, slot.generation});
+    return ids.back();
+  }
+
+  void erase(SlotId id) {
+    assert(contains(id));
+    Slot &slot = table[id.index];
+    quint32 hole = slot.dense, last = values.size() - 1;
+    if (hole != last) {
+      values[hole] = std::move(values[last]);
+      ids[hole] = ids[last];
+      table[ids[hole].index].dense = hole;
+    }
+    values.pop_back();
+    ids.pop_back();
+    slot.generation++;
+    freeSlots.push_back(id.index);
+  }
+
+  bool contains(SlotId id) const {
+    return id.index < table.size() &&
+           table[id.index].generation == id.generation;
+  }
+
+  T &operator[](SlotId id) {
+    assert(contains(id));
+    return values[table[id.index].dense];
+  }
+  const T &operator[](SlotId id) const {
+    assert(contains(id));
+    return values[table[id.index].dense];
+  }
+
+  size_t size() const { return values.size(); }
+  typename std::vector<T>::iterator begin() { return values.begin(); }
+  typename std::vector<T>::iterator end() { return values.end(); }
+  typename std::vector<T>::const_iterator begin() const {
+    return values.begin();
+  }
+  typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+private:
+  struct Slot {
+    quint32 generation;
+    quint32 dense; // index in values while the slot is used
+  };
+
+  std::vector<T> values;
+  std::vector<SlotId> ids; // of values, to find the slot of a moved value
+  std::vector<Slot> table; // not "slots", which Qt defines as a macro
+  std::vector<quint32> freeSlots;
+};
+
+#endif // SLOTMAP_H
@@ -0,0 +1,244 @@
+#include "steadystate.h"
+#include "simulation.h"
+#include "throughput.h"
+#include <memory>
+
+SteadyState::SteadyState(Simulation &simulation, Scheduler &scheduler)
+    : simulation(simulation), scheduler(scheduler), enabled_(false),
+      dirty(true), frame(0) {}
+
+void SteadyState::setEnabled(bool enabled) {
+  if (!enabled) {
+    thawAll();
+  }
+  enabled_ = enabled;
+  dirty = true;
+  frame = 0;
+}
+
+bool SteadyState::enabled() const { return enabled_; }
+
+void SteadyState::advance() {
+  CenterModel *center = simulation.center();
+  if (!enabled_ || !center) {
+    return;
+  }
+  if (dirty) {
+    rebuild();
+  }
+
+  const PortGraph &graph = simulation.portGraph();
+  for (auto &[item, input] : center->received) {
+    int o = graph.producer(input);
+    lines[lineOf.at(graph.outputOwner(o))].windows.back()[item]++;
+  }
+  for (auto &line : lines) {
+    if (!line.frozen) {
+      continue;
+    }
+    for (auto &[item, rate] : line.rates) {
+      qreal &owed = line.owed[item];
+      for (owed += rate; owed >= 1; owed -= 1) {
+        center->received.push_back({item, -1});
+      }
+    }
+  }
+
+  if (++frame == WINDOW) {
+    frame = 0;
+    endWindow();
+  }
+}
+
+void SteadyState::thaw(DeviceModel *device) {
+  // lineOf may still hold removed devices until the rebuild, but those were
+  // in lines thawed when they were removed
+  auto it = lineOf.find(device);
+  if (it != lineOf.end()) {
+    thaw(lines[it->second]);
+  }
+}
+
+void SteadyState::thawAll() {
+  for (auto &line : lines) {
+    thaw(line);
+  }
+}
+
+void SteadyState::invalidate() { dirty = true; }
+
+int SteadyState::frozenCount() const {
+  int count = 0;
+  for (auto &line : lines) {
+    if (line.frozen) {
+      count += line.devices.size();
+    }
+  }
+  return count;
+}
+
+void SteadyState::rebuild() {
+  dirty = false;
+  std::vector<Line> old;
+  old.swap(lines);
+  lineOf.clear();
+
+  const PortGraph &graph = simulation.portGraph();
+  CenterModel *center = simulation.center();
+  std::unordered_map<DeviceModel *, DeviceModel *> parent;
+  auto find = [&](DeviceModel *d) {
+    while (parent[d] != d) {
+      d = parent[d] = parent[parent[d]];
+    }
+    return d;
+  };
+  for (auto &[dev, desc] : simulation.devices()) {
+    parent[dev] = dev;
+  }
+  for (auto [o, i] : graph.edges()) {
+    DeviceModel *a = graph.outputOwner(o), *b = graph.inputOwner(i);
+    if (a != center && b != center) {
+      parent[find(a)] = find(b);
+    }
+  }
+
+  std::unordered_map<DeviceModel *, int> lineOfRoot;
+  for (auto &[dev, desc] : simulation.devices()) {
+    if (dev == center) {
+      continue;
+    }
+    auto [it, added] = lineOfRoot.insert({find(dev), lines.size()});
+    if (added) {
+      lines.emplace_back();
+      lines.back().windows.emplace_back();
+    }
+    lines[it->second].devices.push_back(dev);
+    lineOf[dev] = it->second;
+  }
+  for (PortEntry e : center->ports()) {
+    int o = graph.producer(e.port->id());
+    if (o >= 0) {
+      lines[lineOf.at(graph.outputOwner(o))].outputs.push_back(o);
+    }
+  }
+
+  // nothing next to a frozen line was edited, see thaw(), so it is the same
+  // line after the rebuild; a line that looks the same keeps its fractions of
+  // items too, or every thaw and freeze would drop up to one of each
+  for (auto &line : old) {
+    auto it = lineOf.find(line.devices.front());
+    if (it == lineOf.end() ||
+        lines[it->second].devices.size() != line.devices.size()) {
+      assert(!line.frozen);
+      continue;
+    }
+    Line &same = lines[it->second];
+    same.owed = line.owed;
+    if (line.frozen) {
+      same.frozen = true;
+      same.rates = line.rates;
+    }
+  }
+}
+
+void SteadyState::endWindow() {
+  std::unique_ptr<Throughput> throughput; // only solved if needed
+  for (auto &line : lines) {
+    if (line.frozen) {
+      continue;
+    }
+    line.windows.emplace_back();
+    if (line.windows.size() > STEADY_WINDOWS + 1) {
+      line.windows.erase(line.windows.begin());
+    }
+    if (line.windows.size() <= STEADY_WINDOWS) {
+      continue;
+    }
+    if (!throughput) {
+      throughput.reset(new Throughput(simulation));
+    }
+    std::map<const Item *, qreal> expected; // per window
+    for (int o : line.outputs) {
+      for (auto &[item, rate] : throughput->outputItems(o)) {
+        expected[item] += rate * WINDOW / FPS;
+      }
+    }
+    if (steady(line, expected)) {
+      freeze(line, expected);
+    }
+  }
+}
+
+bool SteadyState::steady(const Line &line,
+                         const std::map<const Item *, qreal> &expected) {
+  // the last window is the one just started
+  for (int k = 0; k < STEADY_WINDOWS; k++) {
+    const counts_t &counts = line.windows[k];
+    auto close = [](qreal got, qreal want) {
+      // a window need not hold a whole number of periods of the line
+      return qAbs(got - want) <= 0.05 * want + 1;
+    };
+    for (auto &[item, n] : counts) {
+      auto it = expected.find(item);
+      if (!close(n, it == expected.end() ? 0 : it->second)) {
+        return false;
+      }
+    }
+    for (auto &[item, want] : expected) {
+      auto it = counts.find(item);
+      if (!close(it == counts.end() ? 0 : it->second, want)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void SteadyState::freeze(Line &line,
+                         const std::map<const Item *, qreal> &expected) {
+  // a slow line only delivers a few items per window, the counts confirm the
+  // solved rates but are too coarse to replace them
+  line.rates.clear();
+  for (auto &[item, n] : expected) {
+    line.rates[item] = n / WINDOW;
+  }
+  // the scheduler keeps each device's phase, see Scheduler::add()
+  for (auto dev : line.devices) {
+    scheduler.remove(dev);
+  }
+  pause(line, true);
+  line.frozen = true;
+}
+
+void SteadyState::thaw(Line &line) {
+  if (line.frozen) {
+    for (auto dev : line.devices) {
+      scheduler.add(dev);
+    }
+    pause(line, false);
+    line.frozen = false;
+    line.rates.clear();
+  }
+  // what was counted before an edit says nothing about after it
+  line.windows.assign(1, counts_t());
+}
+
+void SteadyState::pause(const Line &line, bool paused) {
+  CenterModel *center = simulation.center();
+  if (!center) {
+    return;
+  }
+  const PortGraph &graph = simulation.portGraph();
+  for (int o : line.outputs) {
+    int i = graph.consumer(o);
+    for (int k = 0; k < (int)center->in.size(); k++) {
+      if (center->in[k].id() == i) {
+        center->paused[k] = paused;
+      }
+    }
+  }
+  // it may have gone to sleep with an item waiting on a paused input
+  if (!paused) {
+    scheduler.wake(center);
+  }
+}
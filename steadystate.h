@@ -0,0 +1,68 @@
+#ifndef STEADYSTATE_H
+#define STEADYSTATE_H
+
+#include "devicemodel.h"
+#include "scheduler.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class Simulation;
+
+// Level of detail for production lines that have settled. A line is a set of
+// devices connected through ports, not counting the inputs of the center,
+// which takes whatever it is offered, so lines do not affect each other.
+// What every line delivers to the center is counted over windows of WINDOW
+// frames. Once STEADY_WINDOWS windows in a row match what Throughput predicts
+// for the line, it is frozen: its devices leave the scheduler, and the center
+// is credited the items at the confirmed rates instead. The center does not
+// take what the line had already sent either, that is delivered once the line
+// is thawed, so a freeze only ever stands in for the time it lasts.
+// Editing a device of a frozen line or next to it, or changing the ratios,
+// thaws the line, which resumes from the state it was frozen in.
+class SteadyState {
+public:
+  explicit SteadyState(Simulation &simulation, Scheduler &scheduler);
+
+  void setEnabled(bool enabled); // off by default, turning it off thaws all
+  bool enabled() const;
+  // after the frame's commit, before CenterModel::deliver()
+  void advance();
+  // before the device, or the ports next to it, change
+  void thaw(DeviceModel *device);
+  void thawAll();
+  void invalidate(); // the port graph changed, lines are rebuilt
+  int frozenCount() const; // devices
+
+private:
+  static constexpr int WINDOW = 600; // frames
+  static constexpr int STEADY_WINDOWS = 2;
+
+  typedef std::map<const Item *, qint64> counts_t;
+  struct Line {
+    std::vector<DeviceModel *> devices;
+    std::vector<int> outputs; // into the center
+    std::vector<counts_t> windows; // the last ones, the current one last
+    bool frozen = false;
+    std::map<const Item *, qreal> rates; // items per frame while frozen
+    // fractions of items not credited, kept while thawed
+    std::map<const Item *, qreal> owed;
+  };
+
+  void rebuild();
+  void endWindow();
+  bool steady(const Line &line, const std::map<const Item *, qreal> &expected);
+  void freeze(Line &line, const std::map<const Item *, qreal> &expected);
+  void thaw(Line &line);
+  void pause(const Line &line, bool paused); // the center's inputs from line
+
+  Simulation &simulation;
+  Scheduler &scheduler;
+  bool enabled_;
+  bool dirty;
+  int frame; // in the current window
+  std::vector<Line> lines;
+  std::unordered_map<DeviceModel *, int> lineOf;
+};
+
+#endif // STEADYSTATE_H
@@ -0,0 +1,108 @@
+#include "taskpool.h"
+#include <QThread>
+#include <cassert>
+
+static thread_local int currentWorker = 0;
+
+int TaskPool::threadCount(int threads) {
+  if (threads <= 0) {
+    threads = QThread::idealThreadCount();
+  }
+  return std::max(threads, 1);
+}
+
+TaskPool::TaskPool(int threads)
+    : queues(threadCount(threads)), generation(0), stopping(false),
+      remaining(0) {
+  for (int i = 1; i < (int)queues.size(); i++) {
+    workers.emplace_back([this, i] { loop(i); });
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> guard(state);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+int TaskPool::size() const { return queues.size(); }
+
+int TaskPool::workerIndex() { return currentWorker; }
+
+void TaskPool::run(std::vector<task_t> &tasks) {
+  assert(currentWorker == 0);
+  if (tasks.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(state);
+    for (size_t i = 0; i < tasks.size(); i++) {
+      Queue &q = queues[i % queues.size()];
+      std::lock_guard<std::mutex> qGuard(q.lock);
+      q.tasks.push_back(&tasks[i]);
+    }
+    remaining = tasks.size();
+    generation++;
+  }
+  wakeup.notify_all();
+  work(0);
+  // the last tasks may still be running on workers
+  std::unique_lock<std::mutex> lock(state);
+  done.wait(lock, [this] { return remaining == 0; });
+}
+
+void TaskPool::loop(int self) {
+  currentWorker = self;
+  quint64 seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(state);
+      wakeup.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+    work(self);
+  }
+}
+
+void TaskPool::work(int self) {
+  while (task_t *task = take(self)) {
+    (*task)();
+    if (--remaining == 0) {
+      // under the lock, or run() could miss the notification between
+      // checking remaining and going to sleep
+      std::lock_guard<std::mutex> guard(state);
+      done.notify_all();
+    }
+  }
+}
+
+TaskPool::task_t *TaskPool::take(int self) {
+  int n = queues.size();
+  {
+    Queue &q = queues[self];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.tasks.empty()) {
+      task_t *task = q.tasks.back();
+      q.tasks.pop_back();
+      return task;
+    }
+  }
+  for (int k = 1; k < n; k++) {
+    Queue &q = queues[(self + k) % n];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.tasks.empty()) {
+      task_t *task = q.tasks.front();
+      q.tasks.pop_front();
+      return task;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,51 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads with one task deque each. run() deals the
+// tasks out round robin and takes part itself; a thread works its own deque
+// from the back and, once that is empty, steals from the front of the others,
+// so a few long tasks do not leave the remaining threads idle.
+class TaskPool {
+public:
+  // threads counts the calling thread, 0 means one per core
+  explicit TaskPool(int threads = 0);
+  ~TaskPool();
+
+  int size() const;
+  // returns once every task has finished
+  void run(std::vector<std::function<void()>> &tasks);
+  // 0 on the thread calling run(), 1 .. size() - 1 on the workers
+  static int workerIndex();
+
+private:
+  typedef std::function<void()> task_t;
+  struct Queue {
+    std::mutex lock;
+    std::deque<task_t *> tasks;
+  };
+
+  static int threadCount(int threads);
+  void loop(int self);
+  void work(int self);
+  task_t *take(int self);
+
+  std::vector<Queue> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex state;
+  std::condition_variable wakeup, done;
+  quint64 generation; // bumped by every run()
+  bool stopping;
+  std::atomic<int> remaining;
+};
+
+#endif // TASKPOOL_H
@@ -0,0 +1,298 @@
+#include "throughput.h"
+#include <deque>
+
+Throughput::Throughput(const Simulation &simulation)
+    : graph(simulation.portGraph()), outputNode(graph.outputCount(), -1),
+      inputNode(graph.inputCount(), -1), shares(graph.outputCount()),
+      outputRates(graph.outputCount()) {
+  for (auto &[device, desc] : simulation.devices()) {
+    addNode(device);
+  }
+  propagateShares();
+  solveRates();
+}
+
+void Throughput::addNode(DeviceModel *device) {
+  Node n;
+  n.device = device;
+  n.sink = dynamic_cast<TrashModel *>(device) ||
+           dynamic_cast<CenterModel *>(device);
+  n.capacity = device->speed() * device->ratio();
+  if (dynamic_cast<BeltModel *>(device)) {
+    n.capacity /= BeltModel::callsPerItem();
+  } else if (auto m = dynamic_cast<MinerModel *>(device)) {
+    if (!m->factory) {
+      n.capacity = 0;
+    }
+  }
+  n.rate = n.capacity;
+  n.limit = -1;
+  int id = nodes.size();
+  // ports() lists them in a fixed order, see e.g. CutterModel::LAYOUT
+  for (PortEntry e : device->ports()) {
+    Port *port = e.port;
+    if (port->kind() == Port::INPUT) {
+      n.inputs.push_back(port->id());
+      inputNode[port->id()] = id;
+    } else {
+      n.outputs.push_back(port->id());
+      outputNode[port->id()] = id;
+    }
+  }
+  nodes.push_back(n);
+  index.insert({device, id});
+}
+
+// the items an input is fed, items only count if they are sent
+static std::map<const Item *, qreal>
+received(const PortGraph &graph,
+         const std::vector<std::map<const Item *, qreal>> &shares, int input) {
+  std::map<const Item *, qreal> ret;
+  int o = graph.producer(input);
+  if (o < 0) {
+    return ret;
+  }
+  qreal total = 0;
+  for (auto &[item, f] : shares[o]) {
+    if (item) {
+      ret[item] = f;
+      total += f;
+    }
+  }
+  for (auto &[item, f] : ret) {
+    f /= total;
+  }
+  return ret;
+}
+
+Throughput::share_t Throughput::transform(const Node &n, int output) const {
+  share_t ret;
+  if (auto m = dynamic_cast<MinerModel *>(n.device)) {
+    if (m->factory) {
+      ret[m->factory->createItem()] = 1;
+    }
+    return ret;
+  }
+  if (dynamic_cast<MixerModel *>(n.device)) {
+    // consecutive items are taken to be independent
+    for (auto &[a, fa] : received(graph, shares, n.inputs[0])) {
+      for (auto &[b, fb] : received(graph, shares, n.inputs[1])) {
+        auto mine = dynamic_cast<const Mine *>(a);
+        auto trait = dynamic_cast<const TraitMine *>(b);
+        if (mine && trait) {
+          ret[mine->setTrait(trait->getTrait())] += fa * fb;
+        }
+      }
+    }
+    return ret;
+  }
+  for (auto &[item, f] : received(graph, shares, n.inputs[0])) {
+    auto mine = dynamic_cast<const Mine *>(item);
+    if (dynamic_cast<BeltModel *>(n.device)) {
+      ret[item] += f;
+    } else if (dynamic_cast<RotatorModel *>(n.device)) {
+      ret[mine ? mine->rotateR() : item] += f;
+    } else if (dynamic_cast<CutterModel *>(n.device) && mine) {
+      // outU first, see CutterModel::LAYOUT
+      ret[output == 0 ? mine->cutUpper() : mine->cutLower()] += f;
+    }
+  }
+  return ret;
+}
+
+bool Throughput::stalls(const Node &n) const {
+  auto feeds = [&](int k, auto isKind) {
+    for (auto &[item, f] : received(graph, shares, n.inputs[k])) {
+      if (!isKind(item)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  auto isMine = [](const Item *item) {
+    return dynamic_cast<const Mine *>(item) != nullptr;
+  };
+  auto isTrait = [](const Item *item) {
+    return dynamic_cast<const TraitMine *>(item) != nullptr;
+  };
+  if (auto c = dynamic_cast<CutterModel *>(n.device)) {
+    return c->stall || feeds(0, isMine);
+  }
+  if (auto m = dynamic_cast<MixerModel *>(n.device)) {
+    return m->stall || feeds(0, isMine) || feeds(1, isTrait);
+  }
+  return false;
+}
+
+// Nodes to visit again because a neighbour changed, first in first out and
+// each queued once. All of them are queued to begin with; a node visited more
+// than the given number of times is dropped, which only happens around loops.
+class Throughput::Worklist {
+public:
+  Worklist(int size, int visits) : queued(size, true), left(size, visits) {
+    for (int id = 0; id < size; id++) {
+      queue.push_back(id);
+    }
+  }
+
+  bool empty() const { return queue.empty(); }
+
+  int pop() {
+    int id = queue.front();
+    queue.pop_front();
+    queued[id] = false;
+    left[id]--;
+    return id;
+  }
+
+  void push(int id) {
+    if (id >= 0 && !queued[id] && left[id] > 0) {
+      queued[id] = true;
+      queue.push_back(id);
+    }
+  }
+
+private:
+  std::deque<int> queue;
+  std::vector<bool> queued;
+  std::vector<int> left;
+};
+
+void Throughput::propagateShares() {
+  // the shares of a node only change with those fed to it, so the consumer
+  // is revisited when an output changes
+  Worklist work(nodes.size(), nodes.size() + 1);
+  while (!work.empty()) {
+    Node &n = nodes[work.pop()];
+    for (int k = 0; k < (int)n.outputs.size(); k++) {
+      int o = n.outputs[k];
+      share_t s = transform(n, k);
+      if (s != shares[o]) {
+        shares[o] = s;
+        int i = graph.consumer(o);
+        work.push(i >= 0 ? inputNode[i] : -1);
+      }
+    }
+  }
+  for (auto &n : nodes) {
+    if (stalls(n)) {
+      n.capacity = n.rate = 0;
+    }
+  }
+}
+
+qreal Throughput::sent(int output) const {
+  auto it = shares[output].find(nullptr);
+  return it == shares[output].end() ? 1 : 1 - it->second;
+}
+
+void Throughput::solveRates() {
+  // rates only go down; the constraints of a node involve its producers and
+  // consumers, which are revisited when its rate changes
+  Worklist work(nodes.size(), 4 * nodes.size() + 16);
+  while (!work.empty()) {
+    int id = work.pop();
+    Node &n = nodes[id];
+    if (n.sink) {
+      continue;
+    }
+    qreal r = n.capacity;
+    int limit = -1;
+    auto lower = [&](qreal bound, int by) {
+      if (bound < r * (1 - 1e-9)) {
+        r = bound;
+        limit = by;
+      }
+    };
+    // one item from every input per call
+    for (int i : n.inputs) {
+      int o = graph.producer(i);
+      lower(o >= 0 ? nodes[outputNode[o]].rate * sent(o) : 0,
+            o >= 0 ? outputNode[o] : -1);
+    }
+    // no call while an output that gets items is full
+    for (int o : n.outputs) {
+      qreal f = sent(o);
+      if (f <= 0) {
+        continue;
+      }
+      int i = graph.consumer(o);
+      if (i < 0) {
+        lower(0, -1);
+        continue;
+      }
+      const Node &c = nodes[inputNode[i]];
+      lower((c.sink ? c.capacity : c.rate) / f, inputNode[i]);
+    }
+    if (r != n.rate) {
+      for (int i : n.inputs) {
+        int o = graph.producer(i);
+        work.push(o >= 0 ? outputNode[o] : -1);
+      }
+      for (int o : n.outputs) {
+        int i = graph.consumer(o);
+        work.push(i >= 0 ? inputNode[i] : -1);
+      }
+    }
+    n.rate = r;
+    n.limit = limit;
+  }
+
+  for (auto &n : nodes) {
+    for (int o : n.outputs) {
+      outputRates[o] = n.rate * sent(o);
+    }
+  }
+  for (auto &n : nodes) {
+    if (!n.sink) {
+      continue;
+    }
+    // a sink takes from each input on its own
+    n.rate = 0;
+    for (int i : n.inputs) {
+      int o = graph.producer(i);
+      qreal r = o >= 0 ? qMin(outputRates[o], n.capacity) : 0;
+      n.rate += r;
+      if (dynamic_cast<CenterModel *>(n.device)) {
+        for (auto &[item, f] : received(graph, shares, i)) {
+          delivered_[item] += r * f;
+        }
+      }
+    }
+  }
+}
+
+qreal Throughput::rate(DeviceModel *device) const {
+  return nodes[index.at(device)].rate;
+}
+
+qreal Throughput::outputRate(int output) const { return outputRates[output]; }
+
+std::map<const Item *, qreal> Throughput::outputItems(int output) const {
+  std::map<const Item *, qreal> ret;
+  qreal f = sent(output);
+  if (f <= 0) {
+    return ret;
+  }
+  for (auto &[item, share] : shares[output]) {
+    if (item) {
+      ret[item] = outputRates[output] * share / f;
+    }
+  }
+  return ret;
+}
+
+DeviceModel *Throughput::bottleneck(DeviceModel *device) const {
+  int id = index.at(device);
+  // limits may point back and forth between devices running at the same
+  // rate, stop after visiting every device
+  for (int steps = 0; nodes[id].limit >= 0 && steps < (int)nodes.size();
+       steps++) {
+    id = nodes[id].limit;
+  }
+  return nodes[id].device;
+}
+
+const std::map<const Item *, qreal> &Throughput::delivered() const {
+  return delivered_;
+}
@@ -0,0 +1,61 @@
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+#include "simulation.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Steady-state flow of a factory, computed from the device rates without
+// simulating. Every device is a fixed-rate stage: it handles at most
+// speed() * ratio() items per sec (a belt one per BeltModel::callsPerItem()
+// calls), no more than its inputs supply and no more than its outputs can
+// hand on. Rates start at those capacities and are lowered until every
+// constraint holds, which is what the simulation settles to once the belts
+// have filled up.
+// Which items flow is propagated alongside, as the share of every item on
+// each output; a cutter or mixer that will be fed an item it stalls on is
+// taken as stalled.
+class Throughput {
+public:
+  explicit Throughput(const Simulation &simulation);
+
+  qreal rate(DeviceModel *device) const; // items handled per sec
+  qreal outputRate(int output) const;    // items per sec, by PortGraph id
+  // the same by item
+  std::map<const Item *, qreal> outputItems(int output) const;
+  // the device whose own capacity limits this one, found by following the
+  // constraint that binds; the device itself if it runs at capacity
+  DeviceModel *bottleneck(DeviceModel *device) const;
+  // items per sec reaching the center
+  const std::map<const Item *, qreal> &delivered() const;
+
+private:
+  typedef std::map<const Item *, qreal> share_t; // nullptr for no item
+  struct Node {
+    DeviceModel *device;
+    bool sink; // takes from every input on its own, sends nothing
+    qreal capacity, rate;
+    std::vector<int> inputs, outputs;
+    int limit; // node that bounds rate, -1 for capacity
+  };
+
+  class Worklist;
+
+  void addNode(DeviceModel *device);
+  void propagateShares();
+  share_t transform(const Node &n, int output) const;
+  bool stalls(const Node &n) const;
+  void solveRates();
+  qreal sent(int output) const; // share of calls that send an item
+
+  const PortGraph &graph;
+  std::vector<Node> nodes;
+  std::unordered_map<DeviceModel *, int> index;
+  std::vector<int> outputNode, inputNode; // by port id, -1 for none
+  std::vector<share_t> shares;            // by output id
+  std::vector<qreal> outputRates;
+  std::map<const Item *, qreal> delivered_;
+};
+
+#endif // THROUGHPUT_H
@@ -0,0 +1,36 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+// One writer and one reader share three slots: the writer fills back() and
+// publishes it, the reader takes the newest published slot with front().
+// Neither waits for the other; the reader may skip values, never sees a
+// slot being written, and keeps its slot until its next front().
+template <class T> class TripleBuffer {
+public:
+  TripleBuffer() : back_(0), middle(1), front_(2) {}
+
+  T &back() { return storage[back_]; }
+  void publish() {
+    back_ = middle.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  const T &front() {
+    if (middle.load(std::memory_order_relaxed) & FRESH) {
+      front_ = middle.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    }
+    return storage[front_];
+  }
+
+private:
+  static constexpr int INDEX = 3, FRESH = 4;
+
+  std::array<T, 3> storage;
+  int back_;               // writer's
+  std::atomic<int> middle; // the slot in between, FRESH if not read yet
+  int front_;              // reader's
+};
+
+#endif // TRIPLEBUFFER_H